@@ -0,0 +1,43 @@
+/*
+ * Bluetooth "advertisement" snapshot of the controller state.
+ */
+
+#include "advertise.h"
+#include "linkmonitor.h"
+#include "dashboard.h"
+#include "session.h"
+
+Advertiser advertiser;
+
+void Advertiser::update(const Stats::Snapshot &s)
+{
+    AdvertState next;
+    bzero(next);
+
+    next.version = AdvertState::kVersion;
+    next.profile = session.mode();
+    next.linkLevel = linkMonitor.level();
+    next.txPerSec = min(s.txPerSec, 0xFFFFu);
+    next.dropPerSec = min(s.dropPerSec, 0xFFFFu);
+
+    for (CubeID cube : CubeSet::connected()) {
+        if (cube >= AdvertState::kMaxCubes)
+            continue;
+        next.cubeMask |= 1 << cube;
+        next.battery[cube] = clamp(cube.batteryLevel(), 0.f, 1.f) * 255;
+    }
+
+    if (Bluetooth::isConnected())
+        next.flags |= AdvertState::F_CONNECTED;
+    if (dashboard.isActive())
+        next.flags |= AdvertState::F_DASHBOARD;
+
+    if (published && !memcmp8((const uint8_t*) &next, (const uint8_t*) &current, sizeof next))
+        return;
+
+    current = next;
+    published = true;
+
+    MCC_LOG(LOG_CAT_LINK, LOG_LEVEL_DEBUG, "Advertising state: %d bytes, %18h\n", sizeof current, &current);
+    Bluetooth::advertiseState(current);
+}
@@ -0,0 +1,49 @@
+/*
+ * Bluetooth "advertisement" snapshot of the controller state.
+ *
+ * Mobile apps and host tools can read the advertisement buffer passively,
+ * without opening the data pipe. We publish a small versioned struct; the
+ * layout below is the wire format, so only ever append fields and bump
+ * kVersion when the meaning of an existing byte changes.
+ */
+
+#pragma once
+#include "app.h"
+#include "stats.h"
+
+struct AdvertState {
+    static const uint8_t kVersion = 1;
+    static const unsigned kMaxCubes = 8;
+
+    uint8_t version;
+    uint8_t profile;                // Active report mode, REPORT_MODE_*
+    uint8_t cubeMask;               // Bit N set when cube N is connected
+    uint8_t linkLevel;              // LinkMonitor::Level
+    uint16_t txPerSec;              // Little-endian
+    uint16_t dropPerSec;
+    uint8_t battery[kMaxCubes];     // 0 = empty, 255 = full
+    uint8_t flags;
+    uint8_t reserved;
+
+    enum Flags {
+        F_CONNECTED = 1 << 0,       // Data pipe has a peer
+        F_DASHBOARD = 1 << 1,       // On-cube dashboard is showing
+    };
+};
+
+STATIC_ASSERT(sizeof(AdvertState) == 18);
+
+class Advertiser {
+public:
+    /*
+     * Refresh the advertisement. Called from the main loop once per Stats
+     * capture; the system is only poked when the contents actually changed.
+     */
+    void update(const Stats::Snapshot &s);
+
+private:
+    AdvertState current;
+    bool published;
+};
+
+extern Advertiser advertiser;
@@ -0,0 +1,70 @@
+/*
+ * Accelerometer event aggregation between reports.
+ */
+
+#include "aggregate.h"
+#include "calibrate.h"
+
+AccelAggregator aggregator;
+
+void AccelAggregator::init()
+{
+    bzero(*this);
+}
+
+void AccelAggregator::close(unsigned id, Byte3 current)
+{
+    Window &w = windows[id];
+    AccelSummary &s = summaries[id];
+
+    if (!w.count) {
+        const int8_t v[3] = { current.x, current.y, current.z };
+        for (unsigned i = 0; i < 3; ++i) {
+            s.mean[i] = v[i] * 16;
+            s.min[i] = s.max[i] = s.last[i] = v[i];
+        }
+        s.count = 0;
+        numEmpty++;
+        calibration.onWindow(id, s);
+        return;
+    }
+
+    const int8_t last[3] = { w.last.x, w.last.y, w.last.z };
+    for (unsigned i = 0; i < 3; ++i) {
+        // Round half away from zero, so the average has no bias either way
+        int32_t scaled = w.sum[i] * 16;
+        int32_t half = w.count / 2;
+        s.mean[i] = (scaled + (scaled < 0 ? -half : half)) / int32_t(w.count);
+        s.min[i] = w.min[i];
+        s.max[i] = w.max[i];
+        s.last[i] = last[i];
+        w.sum[i] = 0;
+    }
+
+    s.count = min(w.count, 0xFFFFu);
+    numEvents += w.count;
+    w.count = 0;
+    calibration.onWindow(id, s);
+}
+
+TaiAccel AccelSummary::select(MappingSampling sampling) const
+{
+    int8_t v[3];
+    for (unsigned i = 0; i < 3; ++i) {
+        switch (sampling) {
+        case SAMPLING_AVERAGE:
+            v[i] = (mean[i] + (mean[i] < 0 ? -8 : 8)) / 16;
+            break;
+        case SAMPLING_PEAK:
+            // Whichever extreme is further from rest
+            v[i] = -int(min[i]) > max[i] ? min[i] : max[i];
+            break;
+        default:
+            v[i] = last[i];
+            break;
+        }
+    }
+
+    TaiAccel a = { v[0], v[1], v[2] };
+    return a;
+}
@@ -0,0 +1,79 @@
+/*
+ * Accelerometer event aggregation between reports.
+ *
+ * cubeAccelChange events arrive on the cube's schedule, not ours: several
+ * per report on a fast radio, or none for a while on a quiet one. Sampling
+ * physicalAccel() once per report throws away everything in between, so
+ * instead every event is folded into a per-cube window (sum, min, max,
+ * last, count) in a few words of integer state, and the report closes the
+ * window into a summary. mapping.lua picks which statistic feeds the 8-bit
+ * mapping (Sampling), and the average, with its fractional bits, feeds the
+ * high-res axes. Summaries are already corrected for the cube's bias
+ * (calibrate.h).
+ *
+ * onAccel() runs once per event, so it only adds and compares.
+ */
+
+#pragma once
+#include "app.h"
+#include "mapping.h"
+
+struct AccelSummary {
+    int16_t mean[3];            // Raw * 16, rounded, calibrated; stays in int8 range
+    int8_t min[3];
+    int8_t max[3];
+    int8_t last[3];
+    uint16_t count;             // Events summarized; 0 = none, and the summary is the current reading
+
+    // The statistic mapping.lua asked for, as one raw reading
+    TaiAccel select(MappingSampling sampling) const;
+};
+
+class AccelAggregator {
+public:
+    void init();
+
+    // Every accelerometer event, from the sensor listener
+    void onAccel(unsigned id, Byte3 a)
+    {
+        Window &w = windows[id];
+        const int8_t v[3] = { a.x, a.y, a.z };
+        for (unsigned i = 0; i < 3; ++i) {
+            w.sum[i] += v[i];
+            w.min[i] = w.count ? min(w.min[i], v[i]) : v[i];
+            w.max[i] = w.count ? max(w.max[i], v[i]) : v[i];
+        }
+        w.last = a;
+        w.count++;
+    }
+
+    /*
+     * Summarize the events since the last close and start a new window.
+     * With no events in it, the summary is just the current reading, so a
+     * cube held perfectly still still reports where it is.
+     */
+    void close(unsigned id, Byte3 current);
+
+    // The most recent close()
+    const AccelSummary &summary(unsigned id) const { return summaries[id]; }
+
+    unsigned events() const { return numEvents; }
+    unsigned emptyWindows() const { return numEmpty; }
+
+private:
+    struct Window {
+        int32_t sum[3];
+        int8_t min[3];
+        int8_t max[3];
+        Byte3 last;
+        unsigned count;
+    };
+
+    Window windows[numCubes];
+    AccelSummary summaries[numCubes];
+
+    unsigned numEvents;
+    unsigned numEmpty;
+};
+
+extern AccelAggregator aggregator;
@@ -0,0 +1,48 @@
+/*
+ * Shared state of the MCC (motion collection controller) application.
+ *
+ * main.cpp owns these objects; the helper modules only borrow them.
+ */
+
+#pragma once
+#include <sifteo.h>
+#include "report.h"
+#include "trace.h"
+using namespace Sifteo;
+
+/*
+ * Cube counts, both build options (see the Makefile). Three cubes hold the
+ * controller roles (power.h); more can connect as extra sensors.
+ *
+ * Only the first MCC_DISPLAY_CUBES get a VideoBuffer, which is most of the
+ * RAM a cube costs. The rest are input-only: their sensors are read through
+ * CubeID, and nothing is drawn on them, so the button labels and dashboard
+ * pages of a role or cube without a display are simply skipped. main() logs
+ * the resulting footprint at startup.
+ */
+#ifndef MCC_NUM_CUBES
+#define MCC_NUM_CUBES 3
+#endif
+#ifndef MCC_DISPLAY_CUBES
+#define MCC_DISPLAY_CUBES MCC_NUM_CUBES
+#endif
+
+static const unsigned numCubes = MCC_NUM_CUBES;
+static const unsigned numDisplays = MCC_DISPLAY_CUBES < MCC_NUM_CUBES ? MCC_DISPLAY_CUBES : MCC_NUM_CUBES;
+STATIC_ASSERT(numCubes >= 3 && numCubes <= 24);
+STATIC_ASSERT(numDisplays >= 1);     // Cube 0 shows the connection state
+
+static inline bool hasDisplay(unsigned id)
+{
+    return id < numDisplays;
+}
+
+extern BluetoothPipe <1,1> btPipe;
+extern BluetoothCounters btCounters;
+extern VideoBuffer vid[numDisplays];
+
+// Every report fills a whole BluetoothPacket; see report.h for the layout
+static const unsigned reportSize = REPORT_SIZE;
+
+// Fill a report from the current sensor state (main.cpp)
+void buildReport(uint8_t *bytes, bool drawLabels);
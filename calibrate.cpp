@@ -0,0 +1,218 @@
+/*
+ * Per-cube accelerometer calibration.
+ */
+
+#include "calibrate.h"
+#include "aggregate.h"
+
+Calibration calibration;
+
+static const StoredObject calibrationStore(0x10);
+static const uint32_t kTableVersion = 1;
+
+void Calibration::init()
+{
+    bzero(*this);
+
+    if (calibrationStore.read(table) != sizeof table || table.version != kTableVersion) {
+        bzero(table);
+        table.version = kTableVersion;
+    }
+}
+
+void Calibration::onConnect(unsigned id, uint64_t hwid)
+{
+    Cube &c = cubes[id];
+    bzero(c);
+    c.hwid = hwid;
+
+    for (unsigned i = 0; i < kTableSize; ++i) {
+        const Entry &e = table.entries[i];
+        if (e.stamp && e.hwid == hwid) {
+            for (unsigned a = 0; a < 2; ++a) {
+                c.offset[a] = c.saved[a] = e.offset[a];
+                c.sum[a] = e.offset[a] << kRefineShift;
+            }
+            c.agreed = kConfirmRuns + 1;
+            counters.loads++;
+            MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_INFO, "Calibration: cube %d offset %d,%d (stored)\n",
+                id, c.offset[0], c.offset[1]);
+            return;
+        }
+    }
+}
+
+void Calibration::onWindow(unsigned id, AccelSummary &s)
+{
+    Cube &c = cubes[id];
+
+    if (atRest(s))
+        extendRun(id, s);
+    else
+        c.runWindows = 0;
+
+    for (unsigned i = 0; i < 2; ++i) {
+        int off = c.offset[i];
+        if (!off)
+            continue;
+
+        // The 8-bit statistics take the offset rounded to whole counts
+        int whole = (off + (off < 0 ? -8 : 8)) / 16;
+        s.mean[i] = clamp(s.mean[i] - off, -128 * 16, 127 * 16);
+        s.min[i] = clamp(s.min[i] - whole, -128, 127);
+        s.max[i] = clamp(s.max[i] - whole, -128, 127);
+        s.last[i] = clamp(s.last[i] - whole, -128, 127);
+    }
+}
+
+bool Calibration::atRest(const AccelSummary &s)
+{
+    for (unsigned i = 0; i < 3; ++i)
+        if (s.max[i] - s.min[i] > kStillSpread)
+            return false;
+
+    // Flat, either face up, and not so far off that it's really a tilt
+    return abs(s.mean[2]) >= kFlatZ * 16
+        && abs(s.mean[0]) <= kMaxBias * 16
+        && abs(s.mean[1]) <= kMaxBias * 16;
+}
+
+// Add a rest window (uncorrected) to the cube's run; a long enough run is a rest sample
+void Calibration::extendRun(unsigned id, const AccelSummary &s)
+{
+    Cube &c = cubes[id];
+    SystemTime now = SystemTime::now();
+
+    // The run's means have to stay as still as each window's samples
+    for (unsigned i = 0; c.runWindows && i < 2; ++i) {
+        int low = min<int>(c.runLow[i], s.mean[i]);
+        int high = max<int>(c.runHigh[i], s.mean[i]);
+        if (high - low > kStillSpread * 16)
+            c.runWindows = 0;
+    }
+
+    if (!c.runWindows) {
+        c.runStart = now;
+        c.runEvents = 0;
+        for (unsigned i = 0; i < 2; ++i) {
+            c.runSum[i] = 0;
+            c.runLow[i] = c.runHigh[i] = s.mean[i];
+        }
+    }
+
+    c.runWindows++;
+    c.runEvents += s.count;
+    for (unsigned i = 0; i < 2; ++i) {
+        c.runSum[i] += s.mean[i];
+        c.runLow[i] = min<int>(c.runLow[i], s.mean[i]);
+        c.runHigh[i] = max<int>(c.runHigh[i], s.mean[i]);
+    }
+
+    if (now - c.runStart < TimeDelta::fromMillisec(kRestRunMS))
+        return;
+
+    if (c.runEvents >= kMinRunEvents) {
+        int mean[2];
+        for (unsigned i = 0; i < 2; ++i) {
+            int half = c.runWindows / 2;
+            mean[i] = (c.runSum[i] + (c.runSum[i] < 0 ? -half : half)) / int(c.runWindows);
+        }
+        counters.restRuns++;
+        learn(id, mean);
+    }
+    c.runWindows = 0;
+}
+
+void Calibration::learn(unsigned id, const int *mean)
+{
+    Cube &c = cubes[id];
+    bool confirmed = c.agreed > kConfirmRuns;
+    const int16_t *reference = confirmed ? c.offset : c.candidate;
+
+    bool agrees = c.agreed
+        && abs(mean[0] - reference[0]) <= kAgreeDelta
+        && abs(mean[1] - reference[1]) <= kAgreeDelta;
+
+    if (!confirmed) {
+        if (!agrees) {
+            // The first sample, or the candidate was a tilt held still; start over
+            c.candidate[0] = mean[0];
+            c.candidate[1] = mean[1];
+            c.agreed = 1;
+            return;
+        }
+
+        // Running average of the samples behind the candidate
+        for (unsigned i = 0; i < 2; ++i)
+            c.candidate[i] = (c.candidate[i] * c.agreed + mean[i]) / (c.agreed + 1);
+        if (++c.agreed <= kConfirmRuns)
+            return;
+
+        for (unsigned i = 0; i < 2; ++i) {
+            c.offset[i] = c.candidate[i];
+            c.sum[i] = c.offset[i] << kRefineShift;
+        }
+        c.dirty = true;
+        counters.captures++;
+        MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_INFO, "Calibration: cube %d offset %d,%d (captured)\n",
+            id, c.offset[0], c.offset[1]);
+        return;
+    }
+
+    if (!agrees) {
+        counters.ignoredRuns++;
+        return;
+    }
+
+    // A slow low-pass, with the state at full precision so rounding doesn't drift it
+    for (unsigned i = 0; i < 2; ++i) {
+        c.sum[i] += mean[i] - c.offset[i];
+        c.offset[i] = c.sum[i] >> kRefineShift;
+        if (abs(c.offset[i] - c.saved[i]) >= kSaveDelta)
+            c.dirty = true;
+    }
+}
+
+Calibration::Entry &Calibration::entryFor(uint64_t hwid)
+{
+    Entry *oldest = &table.entries[0];
+    for (unsigned i = 0; i < kTableSize; ++i) {
+        Entry &e = table.entries[i];
+        if (e.stamp && e.hwid == hwid)
+            return e;
+        if (e.stamp < oldest->stamp)
+            oldest = &e;
+    }
+    return *oldest;
+}
+
+void Calibration::flush()
+{
+    SystemTime now = SystemTime::now();
+    if (lastSave.isValid() && now - lastSave < TimeDelta::fromMillisec(kSaveIntervalMS))
+        return;
+
+    bool changed = false;
+    for (unsigned id = 0; id < numCubes; ++id) {
+        Cube &c = cubes[id];
+        if (!c.dirty)
+            continue;
+
+        Entry &e = entryFor(c.hwid);
+        e.hwid = c.hwid;
+        e.offset[0] = c.saved[0] = c.offset[0];
+        e.offset[1] = c.saved[1] = c.offset[1];
+        e.stamp = ++table.nextStamp;
+        c.dirty = false;
+        changed = true;
+
+        MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_INFO, "Calibration: cube %d offset %d,%d\n",
+            id, c.offset[0], c.offset[1]);
+    }
+
+    if (changed) {
+        calibrationStore.write(table);
+        lastSave = now;
+        counters.saves++;
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ * Per-cube accelerometer calibration.
+ *
+ * A cube lying flat should read zero on x and y, but real ones are a few
+ * counts off, which makes tilt thresholds fire unevenly and leaves small
+ * constant axis values that defeat change-only sending.
+ *
+ * A player holding the stick at a small, steady tilt looks a lot like a
+ * biased cube on a table, so rest has to be sustained: every closed
+ * aggregation window (aggregate.h) is checked for a spread of a count or
+ * two with gravity almost all on z, and only an unbroken run of such
+ * windows lasting kRestRunMS, whose means stay as still, with enough real
+ * events in it, counts as one rest sample. A window's own event count
+ * isn't used: at full report rate most windows hold one event or none.
+ *
+ * A new cube's first rest sample is only a candidate. It becomes the
+ * offset once kConfirmRuns more samples agree with it to within
+ * kAgreeDelta, and a disagreeing sample replaces it instead. After that,
+ * samples within kAgreeDelta of the offset refine it slowly; any others
+ * are taken for a tilt and ignored. The offset is subtracted from every
+ * window before mapping, at four fractional bits for the high-res axes.
+ *
+ * Confirmed offsets are kept per hwID() in a StoredObject, so a known cube
+ * starts out calibrated. z isn't corrected: without knowing the sensor's
+ * exact scale for 1 g, its bias can't be told apart from gravity.
+ */
+
+#pragma once
+#include "app.h"
+
+struct AccelSummary;
+
+class Calibration {
+public:
+    // A cube whose offset moves this far from the stored one (raw * 16) is saved again
+    static const int kSaveDelta = 8;
+    static const unsigned kSaveIntervalMS = 60000;
+
+    struct Counters {
+        unsigned restRuns;      // Rest samples taken
+        unsigned ignoredRuns;   // Too far from the offset, so probably a tilt
+        unsigned captures;      // Cubes calibrated from scratch
+        unsigned loads;         // Cubes found in the stored table
+        unsigned saves;
+    };
+
+    void init();
+
+    // From the sensor listener's cube connect
+    void onConnect(unsigned id, uint64_t hwid);
+
+    /*
+     * A window just closed (aggregate.cpp). Learn from it if the cube is
+     * at rest, then correct it.
+     */
+    void onWindow(unsigned id, AccelSummary &s);
+
+    // From the main loop: write changed offsets, never from an event handler
+    void flush();
+
+    int offset(unsigned id, unsigned axis) const { return cubes[id].offset[axis]; }
+    const Counters &stats() const { return counters; }
+
+private:
+    static const unsigned kTableSize = 8;
+    static const unsigned kRestRunMS = 2000;
+    // Provisional: 10 Hz over a run, not yet checked against a real cube's event rate
+    static const unsigned kMinRunEvents = 20;
+    static const unsigned kConfirmRuns = 2;
+    static const int kAgreeDelta = 16;          // Raw * 16, one count
+    static const unsigned kRefineShift = 3;     // In rest runs, so about 16 s
+    static const int kStillSpread = 2;
+    static const int kFlatZ = 48;           // Raw counts; about 3/4 g
+    static const int kMaxBias = 16;
+
+    struct Entry {
+        uint64_t hwid;
+        int16_t offset[2];
+        uint32_t stamp;         // For replacing the least recently seen
+    };
+
+    struct Table {
+        uint32_t version;
+        uint32_t nextStamp;
+        Entry entries[kTableSize];
+    };
+
+    struct Cube {
+        uint64_t hwid;
+        int16_t offset[2];      // Raw * 16
+        int16_t saved[2];
+        int32_t sum[2];         // offset << kRefineShift, once confirmed
+        int16_t candidate[2];   // Raw * 16, awaiting confirmation
+        uint8_t agreed;         // Rest samples behind the candidate, or the offset
+        bool dirty;
+
+        // The current run of rest windows
+        SystemTime runStart;
+        unsigned runWindows;
+        unsigned runEvents;
+        int32_t runSum[2];
+        int16_t runLow[2];
+        int16_t runHigh[2];
+    };
+
+    Table table;
+    Cube cubes[numCubes];
+    SystemTime lastSave;
+    Counters counters;
+
+    static bool atRest(const AccelSummary &s);
+    void extendRun(unsigned id, const AccelSummary &s);
+    void learn(unsigned id, const int *mean);
+    Entry &entryFor(uint64_t hwid);
+};
+
+extern Calibration calibration;
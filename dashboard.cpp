@@ -0,0 +1,108 @@
+/*
+ * On-cube performance dashboard.
+ */
+
+#include "dashboard.h"
+#include "linkmonitor.h"
+#include "session.h"
+#include "power.h"
+#include "tiles.h"
+
+Dashboard dashboard;
+
+bool Dashboard::toggle()
+{
+    active = !active;
+    MCC_LOG(LOG_CAT_UI, LOG_LEVEL_INFO, "Dashboard %s\n", active ? "on" : "off");
+
+    // Cubes showing host tiles keep them
+    for (unsigned i = 0; i < numDisplays; ++i)
+        if (!hostTiles.owns(i))
+            vid[i].bg0rom.erase();
+
+    if (active)
+        draw(stats.last());
+
+    return active;
+}
+
+void Dashboard::drawRow(BG0ROMDrawable &draw, unsigned row, const char *label, unsigned value)
+{
+    // Label left-aligned, value right-aligned in a fixed column
+    String<17> str;
+    str << label;
+    draw.text(vec(1, row), str);
+
+    str.clear();
+    str << Fixed(value, 7);
+    draw.text(vec(8, row), str);
+}
+
+void Dashboard::draw(const Stats::Snapshot &s)
+{
+    if (!active)
+        return;
+
+    for (unsigned i = 0; i < numDisplays; ++i) {
+        if (hostTiles.owns(i))
+            continue;
+        BG0ROMDrawable &draw = vid[i].bg0rom;
+
+        switch (i % NUM_PAGES) {
+            case PAGE_LINK:     drawLink(draw, s); break;
+            case PAGE_LATENCY:  drawLatency(draw, s); break;
+            case PAGE_SENSORS:  drawSensors(draw, s); break;
+        }
+    }
+}
+
+void Dashboard::drawLink(BG0ROMDrawable &draw, const Stats::Snapshot &s)
+{
+    draw.text(vec(1,1), "LINK", draw.WHITE_ON_TEAL);
+    drawRow(draw, 3, "tx/s", s.txPerSec);
+    drawRow(draw, 4, "rx/s", s.rxPerSec);
+    drawRow(draw, 5, "drop/s", s.dropPerSec);
+    drawRow(draw, 7, "queue %", s.queuePercent);
+
+    String<17> str;
+    str << "level  " << LinkMonitor::levelName(linkMonitor.level()) << "  ";
+    draw.text(vec(1,9), str);
+
+    drawRow(draw, 11, "reconn", session.reconnects());
+    drawRow(draw, 12, "fresh", session.lastFreshInputUS());
+}
+
+void Dashboard::drawLatency(BG0ROMDrawable &draw, const Stats::Snapshot &s)
+{
+    draw.text(vec(1,1), "SENSOR>SEND us", draw.WHITE_ON_TEAL);
+    drawRow(draw, 3, "p50", s.latencyP50);
+    drawRow(draw, 4, "p90", s.latencyP90);
+    drawRow(draw, 5, "p99", s.latencyP99);
+    drawRow(draw, 7, "samples", s.latencySamples);
+}
+
+void Dashboard::drawSensors(BG0ROMDrawable &draw, const Stats::Snapshot &s)
+{
+    draw.text(vec(1,1), "ACCEL ev/s", draw.WHITE_ON_TEAL);
+    for (unsigned i = 0; i < kListedCubes; ++i) {
+        String<8> label;
+        label << "cube " << i;
+        drawRow(draw, 3 + i, label.c_str(), s.accelPerSec[i]);
+    }
+
+    // Battery level and the power manager's reaction to it
+    draw.text(vec(1,7), "POWER", draw.WHITE_ON_TEAL);
+    for (unsigned i = 0; i < kListedCubes; ++i) {
+        CubeID cube(i);
+        String<17> str;
+        str << "cube " << i << "  " << Power::levelCode(power.level(i))
+            << Fixed(cube.batteryLevel() * 100, 5) << "%";
+        draw.text(vec(1, 8 + i), str);
+    }
+
+    const Power::Counters &pc = power.stats();
+    drawRow(draw, 12, "no text", pc.textSkipped);
+    drawRow(draw, 13, "no lbl", pc.labelsSkipped);
+    drawRow(draw, 14, "no smp", pc.samplesSkipped);
+    drawRow(draw, 15, "moves", pc.reassignments);
+}
@@ -0,0 +1,54 @@
+/*
+ * On-cube performance dashboard.
+ *
+ * While active, every cube display (app.h) shows one page of live
+ * statistics instead of the normal sensor/connection text. Pages are only
+ * redrawn from the main loop, once per Stats capture, so the dashboard
+ * never adds work to the transmit path.
+ */
+
+#pragma once
+#include "app.h"
+#include "stats.h"
+
+class Dashboard {
+public:
+    enum Page {
+        PAGE_LINK,
+        PAGE_LATENCY,
+        PAGE_SENSORS,
+        NUM_PAGES
+    };
+
+    // The sensors page has rows for this many cubes: the three roles' usual cubes
+    static const unsigned kListedCubes = 3;
+
+    bool isActive() const { return active; }
+
+    /*
+     * The gesture that toggles the dashboard: cube 0 and cube 1 held
+     * top-to-top. Normal play doesn't produce this pairing by accident.
+     */
+    static bool isGesture(unsigned firstID, unsigned firstSide,
+        unsigned secondID, unsigned secondSide)
+    {
+        return firstSide == TOP && secondSide == TOP &&
+            ((firstID == 0 && secondID == 1) || (firstID == 1 && secondID == 0));
+    }
+
+    // Returns the new state. Screens are erased on both transitions.
+    bool toggle();
+
+    void draw(const Stats::Snapshot &s);
+
+private:
+    bool active;
+
+    void drawLink(BG0ROMDrawable &draw, const Stats::Snapshot &s);
+    void drawLatency(BG0ROMDrawable &draw, const Stats::Snapshot &s);
+    void drawSensors(BG0ROMDrawable &draw, const Stats::Snapshot &s);
+
+    static void drawRow(BG0ROMDrawable &draw, unsigned row, const char *label, unsigned value);
+};
+
+extern Dashboard dashboard;
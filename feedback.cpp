@@ -0,0 +1,176 @@
+/*
+ * Visual feedback from the host: the controller's "rumble".
+ */
+
+#include "feedback.h"
+#include "hostlink.h"
+#include "power.h"
+
+Feedback feedback;
+
+// By FEEDBACK_COLOR_*
+static const unsigned palettes[FEEDBACK_NUM_COLORS] = {
+    BG0ROMDrawable::RED, BG0ROMDrawable::ORANGE, BG0ROMDrawable::YELLOW,
+    BG0ROMDrawable::BLUE, BG0ROMDrawable::GRAY
+};
+
+// The border, as four strips: top, bottom, left, right
+static const Int2 borderPos[4] = { vec(0,0), vec(0,15), vec(0,1), vec(15,1) };
+static const Int2 borderSize[4] = { vec(16,1), vec(16,1), vec(1,14), vec(1,14) };
+
+// Blank on the normal screen, between the neighbor ids
+static const Int2 glyphPos = vec(7,7);
+
+unsigned Feedback::palette(unsigned color)
+{
+    return palettes[color];
+}
+
+void Feedback::init(RestoreFn fn)
+{
+    bzero(*this);
+    restore = fn;
+}
+
+void Feedback::onMessage(const BluetoothPacket &packet, uint8_t id, SystemTime now)
+{
+    counters.messages++;
+
+    const uint8_t *entry = packet.bytes() + HOST_MSG_BODY;
+    unsigned length = packet.size() > HOST_MSG_BODY ? packet.size() - HOST_MSG_BODY : 0;
+    for (unsigned i = 0; i < FEEDBACK_MAX_ENTRIES && length >= FEEDBACK_ENTRY_SIZE;
+            ++i, entry += FEEDBACK_ENTRY_SIZE, length -= FEEDBACK_ENTRY_SIZE) {
+        if (entry[FEEDBACK_TARGET] == FEEDBACK_END)
+            break;
+        counters.entries++;
+        if (!accept(entry, now))
+            counters.rejected++;
+    }
+
+    /*
+     * Acknowledged after the next paint even if nothing was accepted; as
+     * with HOST_MSG_PROFILE, the echo only says the message arrived.
+     */
+    if (!id)
+        return;
+    if (arrived.id)
+        counters.overwritten++;
+    arrived.id = id;
+    arrived.arrivedAt = now;
+}
+
+bool Feedback::accept(const uint8_t *entry, SystemTime now)
+{
+    unsigned target = entry[FEEDBACK_TARGET];
+    unsigned id;
+    if (target & FEEDBACK_CUBE)
+        id = target & ~FEEDBACK_CUBE;
+    else if (target < Power::NUM_ROLES)
+        id = power.cubeFor(Power::Role(target));
+    else
+        return false;
+
+    if (!hasDisplay(id) || entry[FEEDBACK_EFFECT] >= FEEDBACK_NUM_EFFECTS
+        || entry[FEEDBACK_COLOR] >= FEEDBACK_NUM_COLORS)
+        return false;
+
+    Effect &e = effects[id];
+    e.effect = entry[FEEDBACK_EFFECT];
+    e.color = entry[FEEDBACK_COLOR];
+    e.arg = entry[FEEDBACK_ARG];
+    e.changed = true;
+    e.lit = true;
+
+    unsigned ms = entry[FEEDBACK_DURATION] * FEEDBACK_DURATION_UNIT_MS;
+    e.ends = ms ? now + TimeDelta::fromMillisec(ms) : SystemTime();
+    return true;
+}
+
+void Feedback::apply(SystemTime now)
+{
+    for (unsigned id = 0; id < numDisplays; ++id) {
+        Effect &e = effects[id];
+        if (e.effect == FEEDBACK_EFFECT_OFF && !e.changed)
+            continue;
+
+        if (e.effect != FEEDBACK_EFFECT_OFF && e.ends.isValid() && now >= e.ends) {
+            e.effect = FEEDBACK_EFFECT_OFF;
+            e.changed = true;
+        }
+
+        if (e.effect == FEEDBACK_EFFECT_FLASH && !e.changed && now >= e.toggle) {
+            e.lit = !e.lit;
+            e.changed = true;
+        }
+
+        if (e.changed) {
+            e.changed = false;
+            draw(id, e);
+            if (e.effect == FEEDBACK_EFFECT_FLASH) {
+                unsigned hz = e.arg ? e.arg : kDefaultFlashHz;
+                e.toggle = now + TimeDelta::fromMillisec(500 / hz);
+            }
+        }
+    }
+
+    if (arrived.id && !drawn.id) {
+        drawn = arrived;
+        arrived.id = 0;
+    }
+}
+
+void Feedback::afterPaint()
+{
+    if (!drawn.id)
+        return;
+
+    // Until the cubes have rendered the frame, the effect isn't on screen
+    System::finish();
+    SystemTime now = SystemTime::now();
+
+    unsigned us = (now - drawn.arrivedAt).nanoseconds() / 1000;
+    counters.painted++;
+    counters.latencySumUS += us;
+    if (us > counters.latencyMaxUS)
+        counters.latencyMaxUS = us;
+
+    hostLink.acknowledge(drawn.id, now);
+    drawn.id = 0;
+}
+
+void Feedback::draw(unsigned id, Effect &e)
+{
+    if (e.effect == FEEDBACK_EFFECT_OFF) {
+        if (e.shown) {
+            blank(id);
+            e.shown = false;
+            restore(id);
+        }
+        return;
+    }
+
+    // Dark half of a flash: still ours, the normal screen comes back at the end
+    e.shown = true;
+    if (e.effect == FEEDBACK_EFFECT_FLASH && !e.lit) {
+        blank(id);
+        return;
+    }
+
+    BG0ROMDrawable &draw = vid[id].bg0rom;
+    unsigned tile = palette(e.color) | draw.SOLID_FG;
+    for (unsigned i = 0; i < 4; ++i)
+        draw.fill(borderPos[i], borderSize[i], tile);
+
+    if (e.effect == FEEDBACK_EFFECT_ICON) {
+        char glyph[2] = { char(e.arg >= ' ' && e.arg < 0x7F ? e.arg : '!'), 0 };
+        draw.text(glyphPos, glyph, palette(e.color));
+    }
+}
+
+void Feedback::blank(unsigned id)
+{
+    BG0ROMDrawable &draw = vid[id].bg0rom;
+    for (unsigned i = 0; i < 4; ++i)
+        draw.fill(borderPos[i], borderSize[i], draw.BLACK | draw.SOLID_BG);
+    draw.text(glyphPos, " ");
+}
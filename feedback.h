@@ -0,0 +1,97 @@
+/*
+ * Visual feedback from the host: the controller's "rumble".
+ *
+ * HOST_MSG_FEEDBACK (report.h) sets an effect per cube: a solid or
+ * blinking border in one of a few colors, optionally with a glyph in the
+ * middle, for a duration or until replaced. The border is where the
+ * neighbor indicators normally are, so it is the one part of the screen
+ * that is both large and cheap to repaint (60 tiles); the glyph goes in a
+ * tile the normal screen leaves blank.
+ *
+ * The read handler only records the message. apply(), from the main loop
+ * right before System::paint(), draws whatever changed, so an effect is on
+ * its way to the cube in the first frame after arrival.
+ *
+ * paint() only queues that frame; the cube hasn't received or shown it
+ * when it returns. So for a frame that carries a message, afterPaint()
+ * waits in System::finish() until the cubes have rendered it, then
+ * releases the message's echo through HostLink with the hold counting
+ * from then, which lets the host measure host-to-screen latency the same
+ * way it measures round trips. Only those frames wait, at most one render;
+ * the cube's own arrival-to-screen time is kept in the counters.
+ */
+
+#pragma once
+#include "app.h"
+
+class Feedback {
+public:
+    static const unsigned kDefaultFlashHz = 8;
+
+    struct Counters {
+        unsigned messages;
+        unsigned entries;
+        unsigned rejected;      // Bad target, effect or color, or a cube without a display
+        unsigned overwritten;   // A second message before the first was painted
+        unsigned painted;       // Messages acknowledged once on screen
+        unsigned latencySumUS;  // Arrival to rendered, over the painted ones
+        unsigned latencyMaxUS;
+    };
+
+    // Redraws what an effect covered once it ends; the border and glyph are blanked first
+    typedef void (*RestoreFn)(unsigned id);
+
+    void init(RestoreFn restore);
+
+    // From HostLink::onMessage(), in the read handler
+    void onMessage(const BluetoothPacket &packet, uint8_t id, SystemTime now);
+
+    // From the main loop, right before and right after System::paint()
+    void apply(SystemTime now);
+    void afterPaint();
+
+    const Counters &stats() const { return counters; }
+
+    // An effect has the cube's border; the restore callback gives it back
+    bool covers(unsigned id) const { return id < numDisplays && effects[id].shown; }
+
+    // BG0_ROM palette for a FEEDBACK_COLOR_* below FEEDBACK_NUM_COLORS
+    static unsigned palette(unsigned color);
+
+private:
+    // A message to echo; id 0 is none
+    struct PendingAck {
+        uint8_t id;
+        SystemTime arrivedAt;
+    };
+
+    struct Effect {
+        uint8_t effect;         // FEEDBACK_EFFECT_*; OFF when idle
+        uint8_t color;
+        uint8_t arg;
+        bool changed;           // Set by onMessage(), drawn by apply()
+        bool shown;             // Something of ours is on the screen
+        bool lit;               // Flash phase
+        SystemTime ends;        // Invalid for "until replaced"
+        SystemTime toggle;      // Next flash phase change
+    };
+
+    Effect effects[numDisplays];
+    RestoreFn restore;
+
+    /*
+     * Separate slots, since System::finish() dispatches events: a message
+     * arriving while afterPaint() waits goes in arrived for the next frame
+     * and leaves the one being rendered alone.
+     */
+    PendingAck arrived;         // Not drawn yet
+    PendingAck drawn;           // Drawn; echo once this frame is rendered
+
+    Counters counters;
+
+    bool accept(const uint8_t *entry, SystemTime now);
+    void draw(unsigned id, Effect &e);
+    void blank(unsigned id);
+};
+
+extern Feedback feedback;
@@ -0,0 +1,43 @@
+/*
+ * High-res axes: oversampling the accelerometers between reports.
+ */
+
+#include "highres.h"
+#include "aggregate.h"
+
+HighRes highRes;
+
+void HighRes::init()
+{
+    bzero(*this);
+}
+
+void HighRes::build(const unsigned *roleCubes, const TaiSample &sample, uint8_t *bytes)
+{
+    if (!mappingHires.enabled)
+        return;
+
+    unsigned shift = mappingHires.smoothing;
+    int half = (1 << shift) >> 1;
+
+    HiresSample h;
+    for (unsigned r = 0; r < 3; ++r) {
+        unsigned id = roleCubes[r];
+        const AccelSummary &s = aggregator.summary(id);
+        int16_t *v = values[id];
+
+        for (unsigned i = 0; i < 3; ++i) {
+            if (primed[id]) {
+                // Round the step half away from zero, so rest settles the same from either side
+                int d = s.mean[i] - v[i];
+                int step = (abs(d) + half) >> shift;
+                v[i] += d < 0 ? -step : step;
+            } else
+                v[i] = s.mean[i];
+            h.cube[r][i] = v[i];
+        }
+        primed[id] = true;
+    }
+
+    mapReportHires(h, sample, bytes);
+}
@@ -0,0 +1,31 @@
+/*
+ * High-res axes: oversampling the accelerometers between reports.
+ *
+ * A cube's accelerometer reads 8 bits, but it sends a new reading far more
+ * often than we send reports, and the readings carry enough noise to
+ * dither the quantization. The average of a report's window (aggregate.h)
+ * therefore resolves finer than one count; it is kept with four fractional
+ * bits, optionally smoothed, and mapped onto the 12-bit lanes of
+ * REPORT_FORMAT_HIRES (mapReportHires() in mapping.h).
+ */
+
+#pragma once
+#include "app.h"
+#include "taimap.h"
+
+class HighRes {
+public:
+    void init();
+
+    /*
+     * Fill the report's high-res lanes from the windows just closed on the
+     * cubes holding each role, if mapping.lua asks for them.
+     */
+    void build(const unsigned *roleCubes, const TaiSample &sample, uint8_t *bytes);
+
+private:
+    int16_t values[numCubes][3];    // Raw * 16, after smoothing
+    bool primed[numCubes];
+};
+
+extern HighRes highRes;
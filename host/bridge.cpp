@@ -0,0 +1,693 @@
+/*
+ * MCC host bridge.
+ */
+
+#include "bridge.h"
+#include "hostclock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+Bridge::~Bridge()
+{
+    if (controllers) {
+        for (unsigned i = 0; i < kMaxControllers; ++i)
+            if (controllers[i].fd >= 0)
+                closeController(i);
+        delete[] controllers;
+    }
+    if (listenFd >= 0)
+        close(listenFd);
+    if (epfd >= 0)
+        close(epfd);
+}
+
+bool Bridge::init(const Options &o)
+{
+    opt = o;
+    memset(&count, 0, sizeof count);
+    decodeToEmit.reset();
+    commitToEmit.reset();
+    sendToScreen.reset();
+    pushToBase.reset();
+    tilesBusy = false;
+    testImage = 0;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("mcc: epoll_create1");
+        return false;
+    }
+
+    controllers = new Controller[kMaxControllers];
+    for (unsigned i = 0; i < kMaxControllers; ++i)
+        controllers[i].fd = -1;
+
+    return true;
+}
+
+bool Bridge::listenUnix(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "mcc: socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        bind(listenFd, (struct sockaddr *) &addr, sizeof addr) < 0 ||
+        listen(listenFd, 128) < 0) {
+        fprintf(stderr, "mcc: listening on %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = kListenTag;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev) == 0;
+}
+
+int Bridge::addStream(int fd)
+{
+    unsigned index;
+    for (index = 0; index < kMaxControllers; ++index)
+        if (controllers[index].fd < 0)
+            break;
+    if (index == kMaxControllers) {
+        count.rejected++;
+        close(fd);
+        return -1;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    // epoll can't wait on regular files; run() reads those every pass
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = index;
+    bool polled = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    if (!polled && errno != EPERM) {
+        fprintf(stderr, "mcc: can't poll input: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    Controller &c = controllers[index];
+    if (!c.js.open(opt.mode, index, opt.name, opt.print)) {
+        if (polled)
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, 0);
+        close(fd);
+        return -1;
+    }
+
+    c.fd = fd;
+    c.polled = polled;
+    numFiles += !polled;
+    c.fill = 0;
+    c.seq.reset();
+    c.clock.reset();
+    c.predict.configure(opt.predictMS * 1000, opt.predictMaxLead);
+    // A FIFO, pipe or file opened for reading only never takes messages
+    c.canWrite = (flags & O_ACCMODE) != O_RDONLY;
+    c.feedbackID = 0;
+    c.feedbackSentNS = 0;
+    for (unsigned i = 0; i < kTileRoles; ++i)
+        c.tiles[i].reset();
+    c.tilesWaiting = 0;
+    c.tileRole = 0;
+    c.tileID = 0;
+    c.tileSentNS = 0;
+    numActive++;
+    count.clients++;
+
+    if (opt.setProfile && !sendMessage(c, HOST_MSG_PROFILE, &opt.profile, 1))
+        count.profileFailed++;
+    return index;
+}
+
+void Bridge::closeController(unsigned index)
+{
+    Controller &c = controllers[index];
+    if (c.polled)
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, 0);
+    else
+        numFiles--;
+    close(c.fd);
+    c.fd = -1;
+    c.js.close();
+    numActive--;
+}
+
+void Bridge::accept()
+{
+    for (;;) {
+        int fd = accept4(listenFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        addStream(fd);
+    }
+}
+
+void Bridge::onReadable(unsigned index)
+{
+    Controller &c = controllers[index];
+
+    // One read per wakeup keeps a busy stream from starving the others
+    ssize_t r = read(c.fd, c.buf + c.fill, sizeof c.buf - c.fill);
+    if (r > 0) {
+        count.bytes += r;
+        c.fill += r;
+        processFrames(index, c);
+    } else if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+        closeController(index);
+    }
+}
+
+void Bridge::processFrames(unsigned index, Controller &c)
+{
+    const uint8_t *frame = c.buf;
+    unsigned remaining = c.fill;
+
+    for (; remaining >= REPORT_FRAME_SIZE; frame += REPORT_FRAME_SIZE, remaining -= REPORT_FRAME_SIZE) {
+        uint64_t start = nowNS();
+        count.frames++;
+
+        if (frame[0] != 0) {
+            count.badType++;
+            continue;
+        }
+
+        ReportState state;
+        decodeReport(frame + 1, state);
+        count.reports++;
+        if (state.format > REPORT_FORMAT_LATEST)
+            count.unknownFormat++;
+
+        if (state.format >= REPORT_FORMAT_SEQUENCED) {
+            SequenceTracker::Counters before = c.seq.counters();
+            c.seq.onReport(state.sequence, state.timestampMS, start);
+            count.lost += c.seq.counters().lost - before.lost;
+            count.late += c.seq.counters().late - before.late;
+            count.duplicates += c.seq.counters().duplicates - before.duplicates;
+            count.resyncs += c.seq.counters().resyncs - before.resyncs;
+
+            // The base restarted; its clock did too
+            if (c.seq.counters().resyncs != before.resyncs) {
+                c.clock.reset();
+                c.predict.reset();
+            }
+        }
+
+        uint64_t committed = 0;
+        if (state.format >= REPORT_FORMAT_ECHO) {
+            // A feedback echo marks a render, not an arrival, so it isn't a clock sample
+            bool shown = state.echo && state.echo == c.feedbackID;
+            if (shown) {
+                state.echo = 0;
+                c.feedbackID = 0;
+                count.feedbackShown++;
+            }
+
+            // Tiles are echoed on arrival like a ping, so they stay clock samples
+            bool applied = state.echo && state.echo == c.tileID;
+
+            committed = c.clock.onReport(state, start);
+
+            if (applied) {
+                bool timed = committed && state.hold != ECHO_HOLD_INVALID;
+                onTileEcho(c, timed ? committed - uint64_t(state.hold) * ECHO_HOLD_UNIT_US * 1000 : start);
+            }
+
+            if (shown && committed && state.hold != ECHO_HOLD_INVALID) {
+                uint64_t shownAt = committed - uint64_t(state.hold) * ECHO_HOLD_UNIT_US * 1000;
+                if (shownAt > c.feedbackSentNS)
+                    sendToScreen.add(shownAt - c.feedbackSentNS);
+            }
+        }
+
+        // Needs base timestamps; arrival times would turn jitter into speed
+        if (c.predict.enabled() && state.format >= REPORT_FORMAT_SEQUENCED
+            && state.mode == REPORT_MODE_JOYSTICK) {
+            c.predict.apply(state, state.timestampUS());
+            count.predicted++;
+        }
+
+        unsigned n = c.js.emit(state);
+        if (n) {
+            count.events += n;
+            count.syncs++;
+        }
+
+        uint64_t end = nowNS();
+        decodeToEmit.add(end - start);
+        if (committed && committed < end)
+            commitToEmit.add(end - committed);
+
+        if (observer)
+            observer(observerContext, index, state);
+    }
+
+    // Keep any partial frame for the next read
+    if (remaining && frame != c.buf)
+        memmove(c.buf, frame, remaining);
+    c.fill = remaining;
+}
+
+void Bridge::sendPings()
+{
+    for (unsigned i = 0; i < kMaxControllers; ++i) {
+        Controller &c = controllers[i];
+        // A tile packet in flight is already a ping, and a new one would hide its echo
+        if (c.fd < 0 || !c.canWrite || c.tileID)
+            continue;
+        if (sendMessage(c, HOST_MSG_PING, 0, 0))
+            count.pings++;
+        else
+            count.pingFailed++;
+    }
+}
+
+// A flash on the stick cube, short enough not to get in the way
+void Bridge::sendTestFeedback()
+{
+    static const uint8_t flash[FEEDBACK_ENTRY_SIZE] = {
+        0, FEEDBACK_EFFECT_FLASH, FEEDBACK_COLOR_RED, 0, 100 / FEEDBACK_DURATION_UNIT_MS
+    };
+
+    for (unsigned i = 0; i < kMaxControllers; ++i)
+        if (controllers[i].fd >= 0 && controllers[i].canWrite)
+            sendFeedback(i, flash, 1);
+}
+
+bool Bridge::sendFeedback(unsigned index, const uint8_t *entries, unsigned n)
+{
+    Controller &c = controllers[index];
+    if (c.fd < 0 || n > FEEDBACK_MAX_ENTRIES)
+        return false;
+
+    uint8_t id = c.clock.allocate();
+    uint64_t now = nowNS();
+    if (!writeMessage(c, HOST_MSG_FEEDBACK, id, entries, n * FEEDBACK_ENTRY_SIZE)) {
+        count.feedbackFailed++;
+        return false;
+    }
+
+    // An earlier one still unacknowledged is overwritten on the base too
+    c.feedbackID = id;
+    c.feedbackSentNS = now;
+    count.feedbacks++;
+    return true;
+}
+
+// Cycle every client's stick cube through two images and back to its status screen
+void Bridge::sendTestTiles()
+{
+    static uint16_t images[2][TileSender::kTiles];
+    static bool built;
+
+    if (!built) {
+        static const uint16_t blank = TILE_BLANK;
+        static const uint16_t block = TILE_SOLID | (FEEDBACK_COLOR_BLUE << 8);
+        static const uint16_t bar = TILE_SOLID | (FEEDBACK_COLOR_RED << 8);
+        static const char text[] = "MCC tiles";
+
+        for (unsigned pos = 0; pos < TileSender::kTiles; ++pos) {
+            unsigned x = pos % TILES_GRID, y = pos / TILES_GRID;
+            images[0][pos] = x >= 5 && x < 11 && y >= 5 && y < 11 ? block : blank;
+            images[1][pos] = y == 10 && x >= 2 && x < 14 ? bar : blank;
+        }
+        for (unsigned i = 0; text[i]; ++i)
+            images[1][7 * TILES_GRID + 3 + i] = uint8_t(text[i]) | (FEEDBACK_COLOR_YELLOW << 8);
+        built = true;
+    }
+
+    unsigned step = testImage++ % 3;
+    for (unsigned i = 0; i < kMaxControllers; ++i) {
+        if (controllers[i].fd < 0 || !controllers[i].canWrite)
+            continue;
+        if (step < 2)
+            pushTiles(i, 0, images[step]);
+        else
+            releaseTiles(i, 0);
+    }
+}
+
+bool Bridge::pushTiles(unsigned index, unsigned role, const uint16_t *image)
+{
+    Controller &c = controllers[index];
+    if (c.fd < 0 || role >= kTileRoles)
+        return false;
+
+    c.tiles[role].push(image, nowNS());
+    c.tilesWaiting |= 1 << role;
+    count.tileImages++;
+    tilesBusy = true;
+    return true;
+}
+
+bool Bridge::releaseTiles(unsigned index, unsigned role)
+{
+    Controller &c = controllers[index];
+    if (c.fd < 0 || role >= kTileRoles)
+        return false;
+
+    c.tiles[role].release(nowNS());
+    c.tilesWaiting |= 1 << role;
+    count.tileImages++;
+    tilesBusy = true;
+    return true;
+}
+
+/*
+ * Moves every controller's tiles along by at most one packet: a resend if
+ * the one in flight has gone unechoed too long, otherwise the next packet
+ * for whichever role is due, taking turns so one busy cube can't hold up
+ * the others.
+ */
+void Bridge::pumpTiles()
+{
+    uint64_t now = nowNS();
+    uint64_t gap = uint64_t(kTileGapMS) * 1000000ull;
+    uint64_t retry = uint64_t(kTileRetryMS) * 1000000ull;
+    bool busy = false;
+
+    for (unsigned i = 0; i < kMaxControllers; ++i) {
+        Controller &c = controllers[i];
+        if (c.fd < 0 || !c.canWrite)
+            continue;
+
+        if (c.tileID) {
+            busy = true;
+            if (now - c.tileSentNS >= retry && sendTilePacket(c, now))
+                count.tileRetransmits++;
+            continue;
+        }
+
+        // Pushes that turned out to need no packets are done already
+        for (unsigned role = 0; role < kTileRoles; ++role) {
+            if ((c.tilesWaiting & (1 << role)) && !c.tiles[role].pending()) {
+                c.tilesWaiting &= ~(1 << role);
+                count.tileImagesApplied++;
+            }
+        }
+        if (!c.tilesWaiting)
+            continue;
+        busy = true;
+        if (now - c.tileSentNS < gap)
+            continue;
+
+        for (unsigned n = 1; n <= kTileRoles; ++n) {
+            unsigned role = (c.tileRole + n) % kTileRoles;
+            if (!c.tiles[role].pending())
+                continue;
+
+            unsigned tiles;
+            c.tileLength = c.tiles[role].next(role, c.tileBody, tiles);
+            c.tileRole = role;
+            if (sendTilePacket(c, now)) {
+                count.tilePackets++;
+                count.tilesWritten += tiles;
+            }
+            break;
+        }
+    }
+
+    tilesBusy = busy;
+}
+
+/*
+ * Send (or resend) the packet in c.tileBody. It has been taken out of the
+ * sender already, so a full socket leaves it to the retry timer.
+ */
+bool Bridge::sendTilePacket(Controller &c, uint64_t now)
+{
+    c.tileID = c.clock.ping(now);
+    c.tileSentNS = now;
+    if (!writeMessage(c, HOST_MSG_TILES, c.tileID, c.tileBody, c.tileLength)) {
+        count.tileFailed++;
+        return false;
+    }
+    count.tileBytes += c.tileLength;
+    return true;
+}
+
+void Bridge::onTileEcho(Controller &c, uint64_t appliedNS)
+{
+    c.tileID = 0;
+
+    unsigned role = c.tileRole;
+    const TileSender &s = c.tiles[role];
+    if (!(c.tilesWaiting & (1 << role)) || s.pending())
+        return;
+
+    c.tilesWaiting &= ~(1 << role);
+    count.tileImagesApplied++;
+    if (appliedNS > s.pushedAt())
+        pushToBase.add(appliedNS - s.pushedAt());
+}
+
+/*
+ * Every other message is echoed on arrival, so it is also a clock sync
+ * sample; its id comes from the clock. Timed one by one, since a burst to
+ * a thousand clients takes a while.
+ */
+bool Bridge::sendMessage(Controller &c, uint8_t type, const uint8_t *body, unsigned length)
+{
+    return c.canWrite && writeMessage(c, type, c.clock.ping(nowNS()), body, length);
+}
+
+bool Bridge::writeMessage(Controller &c, uint8_t type, uint8_t id, const uint8_t *body, unsigned length)
+{
+    if (!c.canWrite)
+        return false;
+
+    uint8_t frame[REPORT_FRAME_SIZE];
+    memset(frame, 0, sizeof frame);
+    frame[0] = type;
+    if (length)
+        memcpy(frame + 1 + HOST_MSG_BODY, body, length);
+    frame[1 + HOST_MSG_ID] = id;
+
+    ssize_t w = write(c.fd, frame, sizeof frame);
+    if (w == ssize_t(sizeof frame))
+        return true;
+
+    /*
+     * A full socket just skips this message. Anything else (a peer that
+     * went away, or a partial write that would leave it out of frame)
+     * stops writing to this stream for good.
+     */
+    if (w >= 0 || errno != EAGAIN)
+        c.canWrite = false;
+    return false;
+}
+
+void Bridge::run()
+{
+    static const unsigned kMaxEvents = 64;
+    struct epoll_event events[kMaxEvents];
+
+    uint64_t interval = uint64_t(opt.statsInterval) * 1000000000ull;
+    uint64_t pingInterval = uint64_t(opt.pingIntervalMS) * 1000000ull;
+    uint64_t feedbackInterval = uint64_t(opt.feedbackIntervalMS) * 1000000ull;
+    uint64_t tileInterval = uint64_t(opt.tileIntervalMS) * 1000000ull;
+    uint64_t tileGap = uint64_t(kTileGapMS) * 1000000ull;
+    uint64_t nextStats = interval ? nowNS() + interval : 0;
+    uint64_t nextPing = pingInterval ? nowNS() : 0;
+    uint64_t nextFeedback = feedbackInterval ? nowNS() + feedbackInterval : 0;
+    uint64_t nextTiles = tileInterval ? nowNS() + tileInterval : 0;
+    uint64_t nextTilePump = nowNS();
+
+    while (!stopping && (numActive || listenFd >= 0)) {
+        // The earliest of whichever timers are on
+        uint64_t deadline = 0;
+        if (interval)
+            deadline = nextStats;
+        if (pingInterval && (!deadline || nextPing < deadline))
+            deadline = nextPing;
+        if (feedbackInterval && (!deadline || nextFeedback < deadline))
+            deadline = nextFeedback;
+        if (tileInterval && (!deadline || nextTiles < deadline))
+            deadline = nextTiles;
+        if (tilesBusy && (!deadline || nextTilePump < deadline))
+            deadline = nextTilePump;
+
+        int timeout = -1;
+        if (numFiles)
+            timeout = 0;
+        else if (deadline) {
+            uint64_t now = nowNS();
+            timeout = now >= deadline ? 0 : int((deadline - now) / 1000000) + 1;
+        }
+
+        int n = epoll_wait(epfd, events, kMaxEvents, timeout);
+        if (n < 0 && errno != EINTR) {
+            perror("mcc: epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            uint32_t tag = events[i].data.u32;
+            if (tag == kListenTag)
+                accept();
+            else
+                onReadable(tag);
+        }
+
+        for (unsigned i = 0; numFiles && i < kMaxControllers; ++i)
+            if (controllers[i].fd >= 0 && !controllers[i].polled)
+                onReadable(i);
+
+        if (pingInterval && nowNS() >= nextPing) {
+            sendPings();
+            nextPing += pingInterval;
+        }
+
+        if (feedbackInterval && nowNS() >= nextFeedback) {
+            sendTestFeedback();
+            nextFeedback += feedbackInterval;
+        }
+
+        if (tileInterval && nowNS() >= nextTiles) {
+            sendTestTiles();
+            nextTiles += tileInterval;
+        }
+
+        // Echoes can free a controller early, so pump on any wakeup past the gap
+        if (tilesBusy && nowNS() >= nextTilePump) {
+            pumpTiles();
+            nextTilePump = nowNS() + tileGap;
+        }
+
+        if (interval && nowNS() >= nextStats) {
+            printStats(stderr);
+            if (opt.metricsPath)
+                writeMetrics(opt.metricsPath);
+            nextStats += interval;
+        }
+    }
+}
+
+void Bridge::printStats(FILE *f) const
+{
+    fprintf(f, "mcc: clients=%u/%llu frames=%llu reports=%llu syncs=%llu events=%llu "
+        "badType=%llu unknownFormat=%llu rejected=%llu lost=%llu late=%llu "
+        "duplicates=%llu resyncs=%llu pings=%llu pingFailed=%llu profileFailed=%llu "
+        "feedbacks=%llu feedbackFailed=%llu feedbackShown=%llu predicted=%llu\n",
+        numActive, (unsigned long long) count.clients,
+        (unsigned long long) count.frames, (unsigned long long) count.reports,
+        (unsigned long long) count.syncs, (unsigned long long) count.events,
+        (unsigned long long) count.badType, (unsigned long long) count.unknownFormat,
+        (unsigned long long) count.rejected,
+        (unsigned long long) count.lost, (unsigned long long) count.late,
+        (unsigned long long) count.duplicates, (unsigned long long) count.resyncs,
+        (unsigned long long) count.pings, (unsigned long long) count.pingFailed,
+        (unsigned long long) count.profileFailed,
+        (unsigned long long) count.feedbacks, (unsigned long long) count.feedbackFailed,
+        (unsigned long long) count.feedbackShown, (unsigned long long) count.predicted);
+    fprintf(f, "mcc: tileImages=%llu tileImagesApplied=%llu tilePackets=%llu tileBytes=%llu "
+        "tilesWritten=%llu tileRetransmits=%llu tileFailed=%llu\n",
+        (unsigned long long) count.tileImages, (unsigned long long) count.tileImagesApplied,
+        (unsigned long long) count.tilePackets, (unsigned long long) count.tileBytes,
+        (unsigned long long) count.tilesWritten, (unsigned long long) count.tileRetransmits,
+        (unsigned long long) count.tileFailed);
+    decodeToEmit.print(f, "mcc: decode-to-emit");
+    if (commitToEmit.count())
+        commitToEmit.print(f, "mcc: commit-to-emit");
+    if (sendToScreen.count())
+        sendToScreen.print(f, "mcc: feedback-to-screen");
+    if (pushToBase.count())
+        pushToBase.print(f, "mcc: tiles-to-base");
+}
+
+bool Bridge::writeMetrics(const char *path) const
+{
+    // Write to a temporary file and rename, so scrapers never see half a file
+    char tmp[4096];
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        perror(tmp);
+        return false;
+    }
+
+    fprintf(f, "# TYPE mcc_reports_total counter\nmcc_reports_total %llu\n",
+        (unsigned long long) count.reports);
+    fprintf(f, "# TYPE mcc_bad_frames_total counter\nmcc_bad_frames_total %llu\n",
+        (unsigned long long) count.badType);
+    fprintf(f, "# TYPE mcc_decode_to_emit_seconds summary\n");
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+    for (unsigned i = 0; i < 3; ++i)
+        fprintf(f, "mcc_decode_to_emit_seconds{quantile=\"%g\"} %.9f\n",
+            quantiles[i], decodeToEmit.percentile(quantiles[i] * 100) / 1e9);
+    fprintf(f, "mcc_decode_to_emit_seconds_count %llu\n",
+        (unsigned long long) decodeToEmit.count());
+
+    fprintf(f, "# TYPE mcc_commit_to_emit_seconds summary\n");
+    for (unsigned i = 0; i < 3; ++i)
+        fprintf(f, "mcc_commit_to_emit_seconds{quantile=\"%g\"} %.9f\n",
+            quantiles[i], commitToEmit.percentile(quantiles[i] * 100) / 1e9);
+    fprintf(f, "mcc_commit_to_emit_seconds_count %llu\n",
+        (unsigned long long) commitToEmit.count());
+
+    fprintf(f, "# TYPE mcc_feedback_to_screen_seconds summary\n");
+    for (unsigned i = 0; i < 3; ++i)
+        fprintf(f, "mcc_feedback_to_screen_seconds{quantile=\"%g\"} %.9f\n",
+            quantiles[i], sendToScreen.percentile(quantiles[i] * 100) / 1e9);
+    fprintf(f, "mcc_feedback_to_screen_seconds_count %llu\n",
+        (unsigned long long) sendToScreen.count());
+
+    fprintf(f, "# TYPE mcc_tiles_to_base_seconds summary\n");
+    for (unsigned i = 0; i < 3; ++i)
+        fprintf(f, "mcc_tiles_to_base_seconds{quantile=\"%g\"} %.9f\n",
+            quantiles[i], pushToBase.percentile(quantiles[i] * 100) / 1e9);
+    fprintf(f, "mcc_tiles_to_base_seconds_count %llu\n",
+        (unsigned long long) pushToBase.count());
+    fprintf(f, "# TYPE mcc_tile_bytes_total counter\nmcc_tile_bytes_total %llu\n",
+        (unsigned long long) count.tileBytes);
+    fprintf(f, "# TYPE mcc_tiles_written_total counter\nmcc_tiles_written_total %llu\n",
+        (unsigned long long) count.tilesWritten);
+
+    /*
+     * Bridge-wide totals, including controllers that have since
+     * disconnected, get their own names: summing the per-controller series
+     * must not count them twice, and those reset on reconnect anyway.
+     */
+    fprintf(f, "# TYPE mcc_bridge_lost_reports_total counter\nmcc_bridge_lost_reports_total %llu\n",
+        (unsigned long long) count.lost);
+    fprintf(f, "# TYPE mcc_bridge_late_reports_total counter\nmcc_bridge_late_reports_total %llu\n",
+        (unsigned long long) count.late);
+
+    fprintf(f, "# TYPE mcc_lost_reports_total counter\n");
+    fprintf(f, "# TYPE mcc_late_reports_total counter\n");
+    fprintf(f, "# TYPE mcc_jitter_seconds gauge\n");
+    fprintf(f, "# TYPE mcc_clock_offset_seconds gauge\n");
+    fprintf(f, "# TYPE mcc_rtt_seconds gauge\n");
+
+    for (unsigned i = 0; i < kMaxControllers; ++i) {
+        const Controller &c = controllers[i];
+        if (c.fd < 0)
+            continue;
+        const SequenceTracker::Counters &sc = c.seq.counters();
+        fprintf(f, "mcc_lost_reports_total{controller=\"%u\"} %llu\n", i, (unsigned long long) sc.lost);
+        fprintf(f, "mcc_late_reports_total{controller=\"%u\"} %llu\n", i, (unsigned long long) sc.late);
+        fprintf(f, "mcc_jitter_seconds{controller=\"%u\"} %.6f\n", i, c.seq.jitter() / 1e9);
+        if (c.clock.synced()) {
+            fprintf(f, "mcc_clock_offset_seconds{controller=\"%u\"} %.6f\n", i, c.clock.offset() / 1e9);
+            fprintf(f, "mcc_rtt_seconds{controller=\"%u\"} %.6f\n", i, c.clock.rtt() / 1e9);
+        }
+    }
+
+    fclose(f);
+    return rename(tmp, path) == 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * MCC host bridge: decodes report frames from byte streams and feeds them
+ * to virtual joysticks.
+ *
+ * Every input stream (a client on the listening socket, a FIFO, stdin, or
+ * one end of a socketpair) is one controller. Everything is driven from a
+ * single epoll loop; controller slots and their buffers are allocated once
+ * in init(), so the loop itself never allocates. epoll refuses regular
+ * files, but reading one never blocks, so a capture given as a file is
+ * read a chunk per pass of the loop instead.
+ *
+ * Streams we can write to (sockets) also get periodic HOST_MSG_PING
+ * messages, so each controller's reports can be mapped into host time and
+ * the latency from the base committing a report to its uinput event is
+ * measured end to end. They can also be asked to switch report mode
+ * (joystick or mouse) as soon as they connect, and sent visual feedback;
+ * the base acknowledges feedback once it is on screen, which gives the
+ * host-to-screen latency.
+ *
+ * Tile images pushed to a cube go out one packet at a time per controller
+ * (tilesender.h), at most one every kTileGapMS and only once the previous
+ * one has been echoed, so a large image trickles in rather than queueing
+ * ahead of everything else on the base's radio. A tile packet is echoed
+ * when the base applies it, not once rendered, so the tile latency ends
+ * at the base.
+ *
+ * Optionally, joystick axes are moved a short way ahead along their recent
+ * velocity before they're emitted (predictor.h), which hides part of the
+ * link latency at the cost of a bounded error.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <signal.h>
+#include "joystick.h"
+#include "histogram.h"
+#include "seqtrack.h"
+#include "clocksync.h"
+#include "tilesender.h"
+#include "predictor.h"
+
+class Bridge {
+public:
+    static const unsigned kMaxControllers = 1024;
+    static const unsigned kTileRoles = 3;       // Stick, left, right
+    static const unsigned kTileGapMS = 16;      // About one base frame
+    static const unsigned kTileRetryMS = 250;   // Resend an unechoed packet
+
+    struct Options {
+        JoystickOutput::Mode mode;
+        const char *name;           // uinput device name prefix
+        FILE *print;                // For OUT_PRINT
+        unsigned statsInterval;     // Seconds, 0 = only on exit
+        const char *metricsPath;    // Written with every stats print, if set
+        unsigned pingIntervalMS;    // 0 = no clock sync
+        bool setProfile;            // Ask each new client for profile
+        uint8_t profile;            // REPORT_MODE_*
+        unsigned feedbackIntervalMS;    // Test flash to every client; 0 = off
+        unsigned tileIntervalMS;        // Test image to every client; 0 = off
+        unsigned predictMS;             // Axis prediction horizon; 0 = off
+        unsigned predictMaxLead;        // Largest correction, high-res counts
+    };
+
+    struct Counters {
+        uint64_t bytes;
+        uint64_t frames;
+        uint64_t reports;
+        uint64_t events;            // input_events, not counting SYN_REPORT
+        uint64_t syncs;             // SYN_REPORT batches written
+        uint64_t badType;           // Frames with a packet type other than 0
+        uint64_t unknownFormat;     // Reports in a format we only partly decode
+        uint64_t lost;              // From sequence numbers, all controllers
+        uint64_t late;
+        uint64_t duplicates;
+        uint64_t resyncs;           // Base restarts, from sequence and timestamps
+        uint64_t clients;
+        uint64_t rejected;          // Clients turned away, all slots in use
+        uint64_t pings;
+        uint64_t pingFailed;        // Socket full, or the peer went away
+        uint64_t profileFailed;     // Couldn't send opt.profile to a new client
+        uint64_t feedbacks;
+        uint64_t feedbackFailed;
+        uint64_t feedbackShown;     // Acknowledged by the base once on screen
+        uint64_t tileImages;        // pushTiles() and releaseTiles() calls
+        uint64_t tileImagesApplied; // Fully applied on the base; the rest were replaced first
+        uint64_t tilePackets;
+        uint64_t tileBytes;         // Message bodies, retransmits included
+        uint64_t tilesWritten;
+        uint64_t tileRetransmits;
+        uint64_t tileFailed;        // Socket full
+        uint64_t predicted;         // Reports emitted with predicted axes
+    };
+
+    /*
+     * Optional hook, called on the loop thread after every decoded report
+     * has been emitted. Used by the load generator to close its latency loop.
+     */
+    typedef void (*ReportObserver)(void *context, unsigned controller, const ReportState &state);
+
+    Bridge() : epfd(-1), listenFd(-1), controllers(0), numActive(0), numFiles(0), stopping(0),
+        observer(0), observerContext(0) {}
+    ~Bridge();
+
+    bool init(const Options &opt);
+    bool listenUnix(const char *path);
+    // Returns the controller index, or -1 on failure
+    int addStream(int fd);
+
+    /*
+     * Run until requestStop(), or until every stream has closed and there
+     * is no listening socket to wait on.
+     */
+    void run();
+
+    // Safe to call from a signal handler
+    void requestStop() { stopping = 1; }
+
+    void setObserver(ReportObserver fn, void *context)
+    {
+        observer = fn;
+        observerContext = context;
+    }
+
+    /*
+     * Send HOST_MSG_FEEDBACK with count entries of FEEDBACK_ENTRY_SIZE
+     * bytes (report.h). Only the latest one per controller is timed.
+     */
+    bool sendFeedback(unsigned controller, const uint8_t *entries, unsigned count);
+
+    /*
+     * Show image (TileSender::kTiles tile words, report.h) on the cube in
+     * role, or hand it back. Only the changes go out, in the background.
+     */
+    bool pushTiles(unsigned controller, unsigned role, const uint16_t *image);
+    bool releaseTiles(unsigned controller, unsigned role);
+
+    void printStats(FILE *f) const;
+
+    // Prometheus text format, one series per controller for link quality
+    bool writeMetrics(const char *path) const;
+
+    const Counters &counters() const { return count; }
+    const LatencyHistogram &latency() const { return decodeToEmit; }
+    const LatencyHistogram &endToEnd() const { return commitToEmit; }
+    const LatencyHistogram &feedbackLatency() const { return sendToScreen; }
+    const LatencyHistogram &tileLatency() const { return pushToBase; }
+
+private:
+    struct Controller {
+        int fd;
+        unsigned fill;
+        uint8_t buf[REPORT_FRAME_SIZE * 16];
+        JoystickOutput js;
+        SequenceTracker seq;
+        ClockSync clock;
+        AxisPredictor predict;
+        bool polled;                // In epoll; false for a regular file
+        bool canWrite;
+        uint8_t feedbackID;         // Awaiting its echo; 0 = none
+        uint64_t feedbackSentNS;
+
+        TileSender tiles[kTileRoles];
+        uint8_t tilesWaiting;       // Bit N: role N's latest push not yet timed
+        uint8_t tileRole;           // Of the packet in flight, or the last one
+        uint8_t tileID;             // Awaiting its echo; 0 = none
+        uint8_t tileLength;
+        uint8_t tileBody[TILES_BODY_SIZE];
+        uint64_t tileSentNS;
+    };
+
+    // epoll tags above any controller index
+    static const uint32_t kListenTag = 0xFFFFFFFF;
+
+    Options opt;
+    int epfd;
+    int listenFd;
+    Controller *controllers;
+    unsigned numActive;
+    unsigned numFiles;                  // Active controllers that aren't polled
+    volatile sig_atomic_t stopping;
+    ReportObserver observer;
+    void *observerContext;
+
+    Counters count;
+    LatencyHistogram decodeToEmit;
+    LatencyHistogram commitToEmit;      // Base commit, in host time, to emit
+    LatencyHistogram sendToScreen;      // Feedback sent to on screen, in host time
+    LatencyHistogram pushToBase;        // pushTiles() to its last packet applied, not rendered
+    bool tilesBusy;                     // Some controller has tiles to send
+    unsigned testImage;
+
+    void accept();
+    void onReadable(unsigned index);
+    void processFrames(unsigned index, Controller &c);
+    void closeController(unsigned index);
+    void sendPings();
+    void sendTestFeedback();
+    void sendTestTiles();
+    void pumpTiles();
+    bool sendTilePacket(Controller &c, uint64_t nowNS);
+    void onTileEcho(Controller &c, uint64_t appliedNS);
+    bool sendMessage(Controller &c, uint8_t type, const uint8_t *body, unsigned length);
+    bool writeMessage(Controller &c, uint8_t type, uint8_t id, const uint8_t *body, unsigned length);
+};
@@ -0,0 +1,185 @@
+/*
+ * Per-controller clock synchronization with the base.
+ *
+ * The bridge sends HOST_MSG_PING messages; the base echoes each id in its
+ * next report along with how long it held it (see report.h). With t1/t4
+ * the host send/arrival times, t3 the report's base timestamp and t2 =
+ * t3 - hold, each echo gives the usual NTP pair:
+ *
+ *   rtt    = (t4 - t1) - hold
+ *   offset = ((t1 - t2) + (t4 - t3)) / 2      (host minus base)
+ *
+ * Queueing on either leg inflates rtt and skews offset by up to rtt/2, so
+ * like NTP's clock filter we keep the last kWindow samples and trust the
+ * one with the smallest round trip. Samples whose rtt is far above that
+ * minimum are rejected outright and never become the estimate, unless a
+ * whole window's worth in a row are, which means the path itself changed.
+ *
+ * Base timestamps wrap every 65.536 s; they are unwrapped against the most
+ * recent report, which is plenty as long as reports keep flowing.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define MCC_HOST
+#include "../report.h"
+
+class ClockSync {
+public:
+    static const unsigned kWindow = 16;
+
+    struct Counters {
+        uint64_t pings;
+        uint64_t echoes;
+        uint64_t stray;         // Echo of an id we have no send time for
+        uint64_t rejected;      // Hold too long, or rtt far above the minimum
+    };
+
+    ClockSync() { reset(); }
+
+    void reset()
+    {
+        memset(sentAt, 0, sizeof sentAt);
+        memset(window, 0, sizeof window);
+        memset(&count, 0, sizeof count);
+        nextID = 1;
+        numSamples = 0;
+        head = 0;
+        best = 0;
+        rejectRun = 0;
+        haveBase = false;
+    }
+
+    // Record a ping going out now; returns the id to put in HOST_MSG_ID
+    uint8_t ping(uint64_t nowNS)
+    {
+        uint8_t id = allocate();
+        sentAt[id] = nowNS;
+        count.pings++;
+        return id;
+    }
+
+    /*
+     * An id for a message whose echo isn't a clock sample (feedback, which
+     * the base echoes after a paint rather than on arrival). The caller
+     * takes its echo out of the report before onReport() sees it.
+     */
+    uint8_t allocate()
+    {
+        uint8_t id = nextID;
+        nextID = nextID == 255 ? 1 : nextID + 1;
+        sentAt[id] = 0;
+        return id;
+    }
+
+    /*
+     * Call for every REPORT_FORMAT_ECHO report. Consumes any echo, and
+     * returns the report's base timestamp translated into host time, or
+     * 0 until the first usable sample.
+     */
+    uint64_t onReport(const ReportState &s, uint64_t arrivalNS)
+    {
+        int64_t baseNS = unwrap(s.timestampUS()) * 1000;
+
+        if (s.echo)
+            onEcho(s.echo, s.hold, baseNS, arrivalNS);
+
+        if (!numSamples)
+            return 0;
+        return uint64_t(baseNS + window[best].offsetNS);
+    }
+
+    bool synced() const { return numSamples != 0; }
+    int64_t offset() const { return numSamples ? window[best].offsetNS : 0; }
+    uint64_t rtt() const { return numSamples ? window[best].rttNS : 0; }
+    const Counters &counters() const { return count; }
+
+private:
+    // Reject samples whose rtt exceeds kRejectFactor * min + kRejectSlackNS
+    static const unsigned kRejectFactor = 2;
+    static const uint64_t kRejectSlackNS = 500000;
+    static const int64_t kWrapUS = 65536 * 1000;
+
+    struct Sample {
+        uint64_t rttNS;
+        int64_t offsetNS;
+    };
+
+    uint64_t sentAt[256];
+    uint8_t nextID;
+
+    Sample window[kWindow];
+    unsigned numSamples;        // Accepted so far, saturating at kWindow
+    unsigned head;              // Next slot to overwrite
+    unsigned best;              // Smallest rtt in the window
+    unsigned rejectRun;
+
+    bool haveBase;
+    uint32_t lastRawUS;
+    int64_t lastBaseUS;
+
+    Counters count;
+
+    int64_t unwrap(uint32_t rawUS)
+    {
+        if (!haveBase) {
+            haveBase = true;
+            lastRawUS = rawUS;
+            lastBaseUS = rawUS;
+            return lastBaseUS;
+        }
+
+        int64_t delta = (int64_t(rawUS) - lastRawUS) % kWrapUS;
+        if (delta < 0)
+            delta += kWrapUS;
+        if (delta > kWrapUS / 2)
+            return lastBaseUS - (kWrapUS - delta);      // Late report, don't move
+
+        lastRawUS = rawUS;
+        lastBaseUS += delta;
+        return lastBaseUS;
+    }
+
+    void onEcho(uint8_t id, uint8_t hold, int64_t baseNS, uint64_t arrivalNS)
+    {
+        uint64_t t1 = sentAt[id];
+        if (!t1) {
+            count.stray++;
+            return;
+        }
+        sentAt[id] = 0;
+        count.echoes++;
+
+        int64_t holdNS = int64_t(hold) * ECHO_HOLD_UNIT_US * 1000;
+        int64_t flight = int64_t(arrivalNS - t1) - holdNS;
+        if (hold == ECHO_HOLD_INVALID || flight < 0) {
+            count.rejected++;
+            return;
+        }
+
+        Sample s;
+        s.rttNS = flight;
+        s.offsetNS = (int64_t(t1 - baseNS) + holdNS + int64_t(arrivalNS - baseNS)) / 2;
+
+        if (numSamples && s.rttNS > window[best].rttNS * kRejectFactor + kRejectSlackNS) {
+            count.rejected++;
+            if (++rejectRun < kWindow)
+                return;
+            numSamples = 0;
+            head = 0;
+        }
+        rejectRun = 0;
+
+        window[head] = s;
+        head = (head + 1) % kWindow;
+        if (numSamples < kWindow)
+            numSamples++;
+
+        best = 0;
+        for (unsigned i = 1; i < numSamples; ++i)
+            if (window[i].rttNS < window[best].rttNS)
+                best = i;
+    }
+};
@@ -0,0 +1,103 @@
+/*
+ * Fixed-size latency histogram.
+ *
+ * Buckets are log-linear: each power of two is split into kSubBuckets
+ * linear steps, which keeps percentiles within ~12% of the true value
+ * without any allocation, from nanoseconds up to minutes.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+class LatencyHistogram {
+public:
+    static const unsigned kSubBits = 3;
+    static const unsigned kSubBuckets = 1 << kSubBits;
+    static const unsigned kNumBuckets = 64 * kSubBuckets;
+
+    LatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        memset(buckets, 0, sizeof buckets);
+        total = 0;
+        sum = 0;
+        maxValue = 0;
+    }
+
+    void add(uint64_t ns)
+    {
+        buckets[bucketFor(ns)]++;
+        total++;
+        sum += ns;
+        if (ns > maxValue)
+            maxValue = ns;
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (unsigned i = 0; i < kNumBuckets; ++i)
+            buckets[i] += other.buckets[i];
+        total += other.total;
+        sum += other.sum;
+        if (other.maxValue > maxValue)
+            maxValue = other.maxValue;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+    uint64_t mean() const { return total ? sum / total : 0; }
+
+    // Upper edge of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double pct) const
+    {
+        if (!total)
+            return 0;
+        uint64_t target = uint64_t(total * pct / 100.0 + 0.5);
+        if (target < 1)
+            target = 1;
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= target) {
+                uint64_t edge = bucketLimit(i);
+                return edge < maxValue ? edge : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    void print(FILE *f, const char *name) const
+    {
+        fprintf(f, "%s: n=%llu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+            name, (unsigned long long) total, mean() / 1e3,
+            percentile(50) / 1e3, percentile(90) / 1e3, percentile(99) / 1e3,
+            percentile(99.9) / 1e3, maxValue / 1e3);
+    }
+
+private:
+    uint64_t buckets[kNumBuckets];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t maxValue;
+
+    static unsigned bucketFor(uint64_t v)
+    {
+        if (v < kSubBuckets)
+            return unsigned(v);
+        unsigned msb = 63 - __builtin_clzll(v);
+        unsigned sub = unsigned(v >> (msb - kSubBits)) & (kSubBuckets - 1);
+        return (msb - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    static uint64_t bucketLimit(unsigned i)
+    {
+        if (i < kSubBuckets)
+            return i;
+        unsigned msb = i / kSubBuckets + kSubBits - 1;
+        uint64_t sub = i % kSubBuckets;
+        return ((kSubBuckets + sub + 1) << (msb - kSubBits)) - 1;
+    }
+};
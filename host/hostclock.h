@@ -0,0 +1,14 @@
+/*
+ * Monotonic clock for host-side latency measurements.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
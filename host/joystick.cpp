@@ -0,0 +1,257 @@
+/*
+ * Output side of the host bridge: one virtual joystick per controller.
+ */
+
+#include "joystick.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+static const uint16_t axisCodes[REPORT_NUM_AXES] = {
+    ABS_X, ABS_Y, ABS_Z, ABS_RX
+};
+
+/*
+ * Buttons follow the kernel's HID joystick mapping: HID button N becomes
+ * BTN_JOYSTICK + N - 1. This matches what the base produces over HID
+ * (see "new 3 BTN.txt").
+ */
+static inline uint16_t buttonCode(unsigned bit)
+{
+    return BTN_JOYSTICK + bit;
+}
+
+// Indexed by MOUSE_* bit
+static const uint16_t mouseButtonCodes[] = {
+    BTN_LEFT, BTN_RIGHT, BTN_MIDDLE
+};
+static const unsigned numMouseButtons = sizeof mouseButtonCodes / sizeof mouseButtonCodes[0];
+
+// Create the device already configured on fd; closes fd on failure
+static bool createDevice(int &fd, unsigned index, const char *name, const char *suffix)
+{
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof setup);
+    setup.id.bustype = BUS_BLUETOOTH;
+    setup.id.vendor = 0x22fa;       // Sifteo
+    setup.id.product = 0x0105;
+    setup.id.version = index;
+    snprintf(setup.name, sizeof setup.name, "%s %u%s", name, index, suffix);
+
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        fprintf(stderr, "mcc: creating uinput device: %s\n", strerror(errno));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+static void destroyDevice(int &fd)
+{
+    if (fd >= 0) {
+        ioctl(fd, UI_DEV_DESTROY);
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool JoystickOutput::open(Mode m, unsigned i, const char *n, FILE *print)
+{
+    mode = m;
+    index = i;
+    out = print;
+    name = n;
+    resetState();
+
+    if (mode == OUT_UINPUT)
+        return openUinput();
+    return true;
+}
+
+bool JoystickOutput::openUinput()
+{
+    fd = ::open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "mcc: /dev/uinput: %s\n", strerror(errno));
+        return false;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+    ioctl(fd, UI_SET_EVBIT, EV_SYN);
+
+    for (unsigned i = 0; i < REPORT_NUM_BUTTONS; ++i)
+        ioctl(fd, UI_SET_KEYBIT, buttonCode(i));
+
+    for (unsigned i = 0; i < REPORT_NUM_AXES; ++i) {
+        struct uinput_abs_setup abs;
+        memset(&abs, 0, sizeof abs);
+        abs.code = axisCodes[i];
+        abs.absinfo.minimum = -REPORT_HIRES_MAX - 1;
+        abs.absinfo.maximum = REPORT_HIRES_MAX;
+        ioctl(fd, UI_SET_ABSBIT, axisCodes[i]);
+        ioctl(fd, UI_ABS_SETUP, &abs);
+    }
+
+    return createDevice(fd, index, name, "");
+}
+
+bool JoystickOutput::openMouse()
+{
+    mouseFd = ::open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (mouseFd < 0) {
+        fprintf(stderr, "mcc: /dev/uinput: %s\n", strerror(errno));
+        return false;
+    }
+
+    ioctl(mouseFd, UI_SET_EVBIT, EV_KEY);
+    ioctl(mouseFd, UI_SET_EVBIT, EV_REL);
+    ioctl(mouseFd, UI_SET_EVBIT, EV_SYN);
+    ioctl(mouseFd, UI_SET_RELBIT, REL_X);
+    ioctl(mouseFd, UI_SET_RELBIT, REL_Y);
+
+    for (unsigned i = 0; i < numMouseButtons; ++i)
+        ioctl(mouseFd, UI_SET_KEYBIT, mouseButtonCodes[i]);
+
+    return createDevice(mouseFd, index, name, " Mouse");
+}
+
+void JoystickOutput::close()
+{
+    destroyDevice(fd);
+    destroyDevice(mouseFd);
+}
+
+void JoystickOutput::resetState()
+{
+    memset(&last, 0, sizeof last);
+}
+
+unsigned JoystickOutput::emit(const ReportState &next)
+{
+    unsigned n = 0;
+
+    if (next.mode != last.mode) {
+        // Let go of whatever the old device holds; the new one starts at rest
+        ReportState idle;
+        memset(&idle, 0, sizeof idle);
+        idle.mode = last.mode;
+        n = emitReport(idle);
+        last.mode = next.mode;
+    }
+
+    return n + emitReport(next);
+}
+
+unsigned JoystickOutput::emitReport(const ReportState &next)
+{
+    switch (next.mode) {
+    case REPORT_MODE_JOYSTICK:  return emitJoystick(next);
+    case REPORT_MODE_MOUSE:     return emitMouse(next);
+    }
+
+    // A mode from a newer base; nothing we can show for it
+    last = next;
+    return 0;
+}
+
+unsigned JoystickOutput::emitJoystick(const ReportState &next)
+{
+    struct input_event ev[kMaxEvents];
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < REPORT_NUM_AXES; ++i) {
+        if (next.hires[i] != last.hires[i]) {
+            ev[n].type = EV_ABS;
+            ev[n].code = axisCodes[i];
+            ev[n].value = next.hires[i];
+            n++;
+        }
+    }
+
+    unsigned changed = next.buttons ^ last.buttons;
+    while (changed) {
+        unsigned bit = __builtin_ctz(changed);
+        ev[n].type = EV_KEY;
+        ev[n].code = buttonCode(bit);
+        ev[n].value = (next.buttons >> bit) & 1;
+        n++;
+        changed &= changed - 1;
+    }
+
+    last = next;
+    if (n)
+        flush(fd, "js", ev, n);
+    return n;
+}
+
+unsigned JoystickOutput::emitMouse(const ReportState &next)
+{
+    static const uint16_t relCodes[2] = { REL_X, REL_Y };
+
+    struct input_event ev[kMaxEvents];
+    unsigned n = 0;
+
+    // Motion is relative, so every nonzero count is news, repeats included
+    for (unsigned i = 0; i < 2; ++i) {
+        if (next.axis[REPORT_MOUSE_X + i]) {
+            ev[n].type = EV_REL;
+            ev[n].code = relCodes[i];
+            ev[n].value = next.axis[REPORT_MOUSE_X + i];
+            n++;
+        }
+    }
+
+    unsigned changed = (next.buttons ^ last.buttons) & ((1u << numMouseButtons) - 1);
+    while (changed) {
+        unsigned bit = __builtin_ctz(changed);
+        ev[n].type = EV_KEY;
+        ev[n].code = mouseButtonCodes[bit];
+        ev[n].value = (next.buttons >> bit) & 1;
+        n++;
+        changed &= changed - 1;
+    }
+
+    last = next;
+    if (!n)
+        return 0;
+
+    if (mode == OUT_UINPUT && mouseFd < 0 && !openMouse())
+        return n;
+
+    flush(mouseFd, "mouse", ev, n);
+    return n;
+}
+
+// Terminate the batch with SYN_REPORT and send it; ev must have room for it
+void JoystickOutput::flush(int dev, const char *prefix, struct input_event *ev, unsigned n)
+{
+    ev[n].type = EV_SYN;
+    ev[n].code = SYN_REPORT;
+    ev[n].value = 0;
+    n++;
+
+    switch (mode) {
+
+    case OUT_UINPUT:
+        // The kernel timestamps uinput events itself
+        for (unsigned i = 0; i < n; ++i)
+            ev[i].time.tv_sec = ev[i].time.tv_usec = 0;
+        if (write(dev, ev, n * sizeof ev[0]) < 0 && errno != EAGAIN)
+            fprintf(stderr, "mcc: uinput write: %s\n", strerror(errno));
+        break;
+
+    case OUT_PRINT:
+        for (unsigned i = 0; i < n; ++i)
+            fprintf(out, "%s%u type=%u code=0x%03x value=%d\n",
+                prefix, index, ev[i].type, ev[i].code, ev[i].value);
+        break;
+
+    case OUT_NULL:
+        break;
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Output side of the host bridge: one virtual joystick per controller.
+ *
+ * Reports are diffed against the previous state and every change is
+ * written as a single batch of input_events terminated by SYN_REPORT, so
+ * each report costs exactly one write() syscall.
+ *
+ * Axes always span 12 bits. Reports without REPORT_FORMAT_HIRES lanes are
+ * scaled up from 8, so a device keeps one range whichever the base sends.
+ *
+ * A controller in REPORT_MODE_MOUSE drives a second, relative pointer
+ * device instead, created the first time it's needed so joystick-only
+ * setups don't grow a phantom mouse. Switching modes releases everything
+ * held on the device being left.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <linux/input.h>
+
+#define MCC_HOST
+#include "../report.h"
+
+class JoystickOutput {
+public:
+    enum Mode {
+        OUT_UINPUT,     // Real /dev/uinput device
+        OUT_PRINT,      // Human-readable events on a FILE (for testing)
+        OUT_NULL,       // Decode and diff only (for benchmarks)
+    };
+
+    // Axes, sync, and one event per button
+    static const unsigned kMaxEvents = REPORT_NUM_AXES + REPORT_NUM_BUTTONS + 1;
+
+    JoystickOutput() : fd(-1), mouseFd(-1), mode(OUT_NULL), out(0), index(0), name(0) {}
+
+    bool open(Mode mode, unsigned index, const char *name, FILE *print = 0);
+    void close();
+
+    // Forget the previous state, e.g. when a new client takes this slot
+    void resetState();
+
+    /*
+     * Emit whatever changed since the last report. Returns the number of
+     * events written, not counting SYN_REPORT; 0 means nothing changed.
+     */
+    unsigned emit(const ReportState &next);
+
+private:
+    int fd;
+    int mouseFd;            // Created on the first mouse report
+    Mode mode;
+    FILE *out;
+    unsigned index;
+    const char *name;       // Kept for the mouse; the caller's string
+    ReportState last;
+
+    bool openUinput();
+    bool openMouse();
+    unsigned emitReport(const ReportState &next);
+    unsigned emitJoystick(const ReportState &next);
+    unsigned emitMouse(const ReportState &next);
+    void flush(int fd, const char *prefix, struct input_event *ev, unsigned n);
+};
@@ -0,0 +1,125 @@
+/*
+ * mcc-bridge: turn an MCC report stream into Linux joysticks.
+ *
+ * The stream is a sequence of REPORT_FRAME_SIZE-byte frames (see report.h).
+ * Until a real Bluetooth transport is wired up, feed it from a Unix socket,
+ * a FIFO or stdin:
+ *
+ *   mcc-bridge -l /tmp/mcc.sock        # one joystick per connected client
+ *   mcc-bridge -f - < /tmp/mcc.fifo    # one joystick fed from stdin
+ *   mcc-bridge -p -f - < capture.bin   # print events instead of using uinput
+ */
+
+#include "bridge.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static Bridge bridge;
+
+static void onSignal(int)
+{
+    bridge.requestStop();
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-l socket] [-f path|-] [-p | -n] [-s seconds] [-m file] [-P ms] [-M mode] [-F ms] [-T ms] [-X ms] [-E counts] [-N name]\n"
+        "  -l socket   listen on a Unix stream socket, one controller per client\n"
+        "  -f path     read one controller from a FIFO, pipe or file ('-' for stdin)\n"
+        "  -p          print events to stdout instead of creating uinput devices\n"
+        "  -n          decode only, no output (benchmarking)\n"
+        "  -s seconds  print statistics periodically (always printed on exit)\n"
+        "  -m file     also write Prometheus-style metrics to file with each print\n"
+        "  -P ms       clock sync ping interval for socket clients (default 250, 0 = off)\n"
+        "  -M mode     switch socket clients to 'joystick' or 'mouse' reports on connect\n"
+        "  -F ms       flash socket clients' stick cube every ms, timing feedback to screen\n"
+        "  -T ms       push a test image to socket clients' stick cube every ms\n"
+        "  -X ms       predict joystick axes ms ahead to hide link latency (see mcc-predict)\n"
+        "  -E counts   largest prediction correction, in high-res counts (default 128)\n"
+        "  -N name     uinput device name prefix (default \"MCC Joystick\")\n",
+        argv0);
+}
+
+int main(int argc, char **argv)
+{
+    Bridge::Options opt;
+    memset(&opt, 0, sizeof opt);
+    opt.mode = JoystickOutput::OUT_UINPUT;
+    opt.name = "MCC Joystick";
+    opt.print = stdout;
+    opt.pingIntervalMS = 250;
+    opt.predictMaxLead = 128;
+
+    const char *socketPath = 0;
+    const char *streamPath = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "l:f:pns:m:P:M:F:T:X:E:N:h")) != -1) {
+        switch (c) {
+            case 'l': socketPath = optarg; break;
+            case 'f': streamPath = optarg; break;
+            case 'p': opt.mode = JoystickOutput::OUT_PRINT; break;
+            case 'n': opt.mode = JoystickOutput::OUT_NULL; break;
+            case 's': opt.statsInterval = atoi(optarg); break;
+            case 'm': opt.metricsPath = optarg; break;
+            case 'P': opt.pingIntervalMS = atoi(optarg); break;
+            case 'M':
+                opt.setProfile = true;
+                if (!strcmp(optarg, "joystick"))
+                    opt.profile = REPORT_MODE_JOYSTICK;
+                else if (!strcmp(optarg, "mouse"))
+                    opt.profile = REPORT_MODE_MOUSE;
+                else {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'F': opt.feedbackIntervalMS = atoi(optarg); break;
+            case 'T': opt.tileIntervalMS = atoi(optarg); break;
+            case 'X': opt.predictMS = atoi(optarg); break;
+            case 'E': opt.predictMaxLead = atoi(optarg); break;
+            case 'N': opt.name = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (!socketPath && !streamPath) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!bridge.init(opt))
+        return 1;
+
+    if (socketPath && !bridge.listenUnix(socketPath))
+        return 1;
+
+    if (streamPath) {
+        int fd = strcmp(streamPath, "-") ? open(streamPath, O_RDONLY | O_CLOEXEC) : dup(0);
+        if (fd < 0) {
+            perror(streamPath);
+            return 1;
+        }
+        if (bridge.addStream(fd) < 0)
+            return 1;
+    }
+
+    bridge.run();
+    bridge.printStats(stderr);
+    if (opt.metricsPath)
+        bridge.writeMetrics(opt.metricsPath);
+
+    if (socketPath)
+        unlink(socketPath);
+    return 0;
+}
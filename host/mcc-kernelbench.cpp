@@ -0,0 +1,248 @@
+/*
+ * mcc-kernelbench: check the report kernels against the reference Tai
+ * mapping, and time them.
+ *
+ * taiMap() (taimap.h) is the original hand-written mapping. mapReport()
+ * runs whatever mapping.lua compiled to, through the lookup tables or the
+ * packed SWAR kernel (mapping.h). Each kernel has to match the reference
+ * byte for byte, on every value of every input axis and on millions of
+ * random samples, before it's timed. This only makes sense while
+ * mapping.lua describes Tai.
+ *
+ * The steering roll angle (steering.h) is checked against floating-point
+ * atan2 over every accelerometer reading with at least half of 1 g (64
+ * counts) of gravity in it, and timed the same way.
+ *
+ *   mcc-kernelbench [-n random samples] [-i timing passes]
+ */
+
+#include "hostclock.h"
+
+#define MCC_HOST
+#include "../mapping.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+typedef void (*Kernel)(const TaiSample &, uint8_t *);
+
+struct KernelInfo {
+    const char *name;
+    Kernel fn;
+    bool available;
+};
+
+static const KernelInfo kernels[] = {
+    { "taiMap (reference)", taiMap, true },
+    { "mapReport tables", mapReportTables, true },
+    { "mapReport swar", mapReportSwar, mappingSwar.enabled },
+};
+static const unsigned numKernels = sizeof kernels / sizeof kernels[0];
+
+static uint32_t xorshift(uint32_t &s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// Half the samples land near the interesting edges: 0, the trigger, the limits
+static int8_t randomAccel(uint32_t &rng)
+{
+    static const int8_t edges[] = { 0, 1, -1, 29, 30, 31, -29, -30, -31,
+        86, 87, 88, -86, -87, -88, 106, 107, 108, -106, -107, -108, 127, -128 };
+    uint32_t r = xorshift(rng);
+    if (r & 1)
+        return int8_t(r >> 8);
+    return edges[(r >> 8) % sizeof edges];
+}
+
+static void randomSample(TaiSample &s, uint32_t &rng)
+{
+    for (unsigned c = 0; c < 3; ++c) {
+        s.cube[c].x = randomAccel(rng);
+        s.cube[c].y = randomAccel(rng);
+        s.cube[c].z = randomAccel(rng);
+    }
+    uint32_t r = xorshift(rng);
+    for (unsigned c = 0; c < 3; ++c)
+        s.touching[c] = (r >> c) & 1;
+    s.neighboring = (r >> 3) & 1;
+}
+
+static bool check(const KernelInfo &k, const TaiSample &s, unsigned long long &mismatches)
+{
+    uint8_t want[REPORT_SIZE], got[REPORT_SIZE];
+    memset(want, 0, sizeof want);
+    memset(got, 0, sizeof got);
+    taiMap(s, want);
+    k.fn(s, got);
+    if (!memcmp(want, got, sizeof want))
+        return true;
+
+    if (mismatches++ < 5) {
+        printf("  %s mismatch:", k.name);
+        for (unsigned i = 0; i < 6; ++i)
+            printf(" %02x/%02x", want[i], got[i]);
+        printf("  (want/got)\n");
+    }
+    return false;
+}
+
+static bool verify(const KernelInfo &k, unsigned long long randomSamples)
+{
+    unsigned long long mismatches = 0, checked = 0;
+    TaiSample s;
+
+    // Every value on every input axis, with every touch/neighbor combination
+    for (unsigned axis = 0; axis < 9; ++axis) {
+        for (int v = -128; v < 128; ++v) {
+            for (unsigned flags = 0; flags < 16; ++flags) {
+                memset(&s, 0, sizeof s);
+                TaiAccel &a = s.cube[axis / 3];
+                (axis % 3 == 0 ? a.x : axis % 3 == 1 ? a.y : a.z) = int8_t(v);
+                for (unsigned c = 0; c < 3; ++c)
+                    s.touching[c] = (flags >> c) & 1;
+                s.neighboring = (flags >> 3) & 1;
+                check(k, s, mismatches);
+                checked++;
+            }
+        }
+    }
+
+    uint32_t rng = 0x9E3779B9;
+    for (unsigned long long i = 0; i < randomSamples; ++i) {
+        randomSample(s, rng);
+        check(k, s, mismatches);
+        checked++;
+    }
+
+    printf("%-20s %llu samples, %llu mismatches\n", k.name, checked, mismatches);
+    return mismatches == 0;
+}
+
+static void bench(const KernelInfo &k, const TaiSample *samples, unsigned count, unsigned passes)
+{
+    uint8_t report[REPORT_SIZE];
+    memset(report, 0, sizeof report);
+    uint32_t sink = 0;
+
+    uint64_t start = nowNS();
+#ifdef HAVE_TSC
+    uint64_t startTSC = __rdtsc();
+#endif
+    for (unsigned p = 0; p < passes; ++p) {
+        for (unsigned i = 0; i < count; ++i) {
+            // taiMap() ORs into the button bytes
+            report[REPORT_BUTTONS_LO] = report[REPORT_BUTTONS_HI] = 0;
+            k.fn(samples[i], report);
+            sink += report[0] ^ report[3] ^ report[4] ^ report[5];
+        }
+    }
+#ifdef HAVE_TSC
+    uint64_t tsc = __rdtsc() - startTSC;
+#endif
+    uint64_t ns = nowNS() - start;
+
+    double reports = double(count) * passes;
+    printf("%-20s %7.2f ns/report", k.name, ns / reports);
+#ifdef HAVE_TSC
+    printf("  %6.2f TSC cycles/report", tsc / reports);
+#endif
+    printf("  (sink %08x)\n", sink);
+}
+
+static void verifySteering()
+{
+    double worst = 0;
+    int wx = 0, wy = 0, wz = 0;
+    for (int x = -128; x < 128; ++x)
+        for (int y = -128; y < 128; ++y)
+            for (int z = -128; z < 128; ++z) {
+                if (x * x + y * y + z * z < 32 * 32)
+                    continue;
+                double want = atan2(double(x), hypot(double(y), double(z))) * 180 / M_PI;
+                double got = steeringRoll(x, y, z) * 360.0 / 65536;
+                double err = fabs(got - want);
+                if (err > worst) {
+                    worst = err;
+                    wx = x; wy = y; wz = z;
+                }
+            }
+    printf("%-20s max error %.3f deg at (%d, %d, %d)\n", "steeringRoll", worst, wx, wy, wz);
+}
+
+static void benchSteering(const TaiSample *samples, unsigned count, unsigned passes)
+{
+    int sink = 0;
+    uint64_t start = nowNS();
+#ifdef HAVE_TSC
+    uint64_t startTSC = __rdtsc();
+#endif
+    for (unsigned p = 0; p < passes; ++p)
+        for (unsigned i = 0; i < count; ++i) {
+            const TaiAccel &a = samples[i].cube[0];
+            sink += steeringRoll(a.x, a.y, a.z);
+        }
+#ifdef HAVE_TSC
+    uint64_t tsc = __rdtsc() - startTSC;
+#endif
+    uint64_t ns = nowNS() - start;
+
+    double calls = double(count) * passes;
+    printf("%-20s %7.2f ns/call  ", "steeringRoll", ns / calls);
+#ifdef HAVE_TSC
+    printf("  %6.2f TSC cycles/call  ", tsc / calls);
+#endif
+    printf("  (sink %08x)\n", unsigned(sink));
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long randomSamples = 4000000;
+    unsigned passes = 2000;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:i:h")) != -1) {
+        switch (c) {
+            case 'n': randomSamples = strtoull(optarg, 0, 0); break;
+            case 'i': passes = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n random samples] [-i timing passes]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    bool ok = true;
+    for (unsigned i = 1; i < numKernels; ++i) {
+        if (kernels[i].available)
+            ok = verify(kernels[i], randomSamples) && ok;
+        else
+            printf("%-20s not generated for this mapping\n", kernels[i].name);
+    }
+    if (!ok) {
+        printf("FAILED: does mapping.lua still describe Tai?\n");
+        return 1;
+    }
+    verifySteering();
+
+    static const unsigned kSamples = 4096;
+    static TaiSample samples[kSamples];
+    uint32_t rng = 12345;
+    for (unsigned i = 0; i < kSamples; ++i)
+        randomSample(samples[i], rng);
+
+    for (unsigned i = 0; i < numKernels; ++i)
+        if (kernels[i].available)
+            bench(kernels[i], samples, kSamples, passes);
+    benchSteering(samples, kSamples, passes);
+    return 0;
+}
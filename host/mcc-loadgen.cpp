@@ -0,0 +1,454 @@
+/*
+ * mcc-loadgen: many-controller load generator and soak benchmark.
+ *
+ * Synthesizes report streams for hundreds of virtual controllers, built
+ * the way buildReport() on the base builds them (mapping.h), high-res
+ * lanes included, and pushes them through local sockets at a fixed
+ * per-controller rate.
+ *
+ * By default the bridge runs in-process on its own thread, fed through
+ * socketpairs, so we can close the loop and measure send-to-emit latency
+ * per controller and the bridge's CPU cost per report. With -l, we instead
+ * connect to an already running mcc-bridge and only measure what the
+ * sending side sees. Either way, pings from the bridge are echoed the way
+ * the base does, so its clock sync runs under load too.
+ *
+ *   mcc-loadgen -c 500 -r 125 -d 30
+ *   mcc-bridge -n -l /tmp/mcc.sock -s 5 & mcc-loadgen -l /tmp/mcc.sock -c 200
+ */
+
+#include "bridge.h"
+#include "hostclock.h"
+
+#define MCC_HOST
+#include "../mapping.h"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+struct VirtualController {
+    // Send timestamps, handed from the generator to the bridge thread
+    static const unsigned kRing = 1024;
+    uint64_t sentAt[kRing];
+    std::atomic<uint32_t> head, tail;
+
+    int fd;
+    uint64_t next;              // When the next report is due
+    uint8_t pending[REPORT_FRAME_SIZE];
+    unsigned pendingLen;
+
+    // Host messages, and the echo owed for the latest one
+    uint8_t inbox[REPORT_FRAME_SIZE * 4];
+    unsigned inboxFill;
+    uint8_t echoID;
+    uint64_t echoAt;
+
+    // Motion model
+    float phase[3];
+    float speed;
+    uint32_t rng;
+    TaiSample sample;
+    HiresSample hires;          // The same motion, at the aggregator's raw * 16
+    uint8_t sequence;
+
+    uint64_t sent;
+    uint64_t received;
+    uint64_t backpressure;      // Reports skipped because the socket was full
+    LatencyHistogram latency;
+};
+
+struct Options {
+    unsigned controllers;
+    unsigned rate;
+    unsigned seconds;
+    const char *socketPath;
+    unsigned seed;
+};
+
+static uint32_t xorshift(uint32_t &s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+static int8_t clampAccel(float v)
+{
+    return int8_t(v > 127 ? 127 : v < -128 ? -128 : v);
+}
+
+static int16_t clampHires(float v)
+{
+    v *= 16;
+    return int16_t(v > 127 * 16 ? 127 * 16 : v < -128 * 16 ? -128 * 16 : v);
+}
+
+/*
+ * Players tilting cubes: each axis follows a slow sine, with occasional
+ * touches and neighbor contacts. What matters is that all of the Tai
+ * mapping's branches (offset ranges, saturation, every button) get used.
+ */
+static void synthesize(VirtualController &vc, double t)
+{
+    for (unsigned c = 0; c < 3; ++c) {
+        float a = float(t) * vc.speed + vc.phase[c];
+        float x = 100 * sinf(a), y = 100 * sinf(a * 1.3f + 1), z = 70 * cosf(a * 0.7f);
+        vc.sample.cube[c].x = clampAccel(x);
+        vc.sample.cube[c].y = clampAccel(y);
+        vc.sample.cube[c].z = clampAccel(z);
+        vc.hires.cube[c][0] = clampHires(x);
+        vc.hires.cube[c][1] = clampHires(y);
+        vc.hires.cube[c][2] = clampHires(z);
+    }
+
+    uint32_t r = xorshift(vc.rng);
+    if ((r & 0xFF) < 4)
+        vc.sample.touching[(r >> 8) % 3] ^= true;
+    if (((r >> 16) & 0xFF) < 2)
+        vc.sample.neighboring = !vc.sample.neighboring;
+}
+
+static void onReport(void *context, unsigned index, const ReportState &)
+{
+    VirtualController &vc = static_cast<VirtualController *>(context)[index];
+    uint64_t now = nowNS();
+
+    uint32_t tail = vc.tail.load(std::memory_order_relaxed);
+    if (tail == vc.head.load(std::memory_order_acquire))
+        return;
+
+    vc.latency.add(now - vc.sentAt[tail % VirtualController::kRing]);
+    vc.received++;
+    vc.tail.store(tail + 1, std::memory_order_release);
+}
+
+static void readMessages(VirtualController &vc, uint64_t now)
+{
+    ssize_t r;
+    while ((r = read(vc.fd, vc.inbox + vc.inboxFill, sizeof vc.inbox - vc.inboxFill)) > 0) {
+        vc.inboxFill += r;
+
+        const uint8_t *frame = vc.inbox;
+        for (; vc.inboxFill >= REPORT_FRAME_SIZE; frame += REPORT_FRAME_SIZE, vc.inboxFill -= REPORT_FRAME_SIZE) {
+            // Like the base, echo every message we know; none change what we send.
+            // Feedback is "painted" at once, as if the base had a frame ready.
+            bool known = frame[0] == HOST_MSG_PING || frame[0] == HOST_MSG_PROFILE
+                || frame[0] == HOST_MSG_FEEDBACK || frame[0] == HOST_MSG_TILES;
+            if (known && frame[1 + HOST_MSG_ID]) {
+                vc.echoID = frame[1 + HOST_MSG_ID];
+                vc.echoAt = now;
+            }
+        }
+        if (vc.inboxFill && frame != vc.inbox)
+            memmove(vc.inbox, frame, vc.inboxFill);
+    }
+}
+
+static bool flushPending(VirtualController &vc)
+{
+    while (vc.pendingLen) {
+        ssize_t w = write(vc.fd, vc.pending + REPORT_FRAME_SIZE - vc.pendingLen, vc.pendingLen);
+        if (w <= 0)
+            return false;
+        vc.pendingLen -= w;
+    }
+    return true;
+}
+
+static void sendReport(VirtualController &vc, uint64_t now, double t, bool track)
+{
+    if (!flushPending(vc)) {
+        vc.backpressure++;
+        return;
+    }
+
+    uint32_t head = vc.head.load(std::memory_order_relaxed);
+    if (track && head - vc.tail.load(std::memory_order_acquire) >= VirtualController::kRing) {
+        vc.backpressure++;
+        return;
+    }
+
+    synthesize(vc, t);
+
+    uint8_t frame[REPORT_FRAME_SIZE];
+    memset(frame, 0, sizeof frame);
+    mapReport(vc.sample, frame + 1);
+    if (mappingHires.enabled)
+        mapReportHires(vc.hires, vc.sample, frame + 1);
+    stampReport(frame + 1, vc.sequence++, now / 1000);
+    if (vc.echoID)
+        stampEcho(frame + 1, vc.echoID, unsigned((now - vc.echoAt) / 1000));
+
+    /*
+     * Publish the timestamp before the write: the bridge can decode the
+     * frame before write() even returns. If nothing was written, no frame
+     * can consume the slot, so taking it back is safe.
+     */
+    if (track) {
+        vc.sentAt[head % VirtualController::kRing] = now;
+        vc.head.store(head + 1, std::memory_order_release);
+    }
+
+    ssize_t w = write(vc.fd, frame, sizeof frame);
+    if (w <= 0) {
+        if (track)
+            vc.head.store(head, std::memory_order_release);
+        vc.backpressure++;
+        return;
+    }
+    vc.echoID = 0;
+    if (unsigned(w) < sizeof frame) {
+        memcpy(vc.pending, frame, sizeof frame);
+        vc.pendingLen = sizeof frame - w;
+    }
+    vc.sent++;
+}
+
+static uint64_t threadCpuNS()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return (uint64_t(ru.ru_utime.tv_sec) + ru.ru_stime.tv_sec) * 1000000000ull
+        + (uint64_t(ru.ru_utime.tv_usec) + ru.ru_stime.tv_usec) * 1000ull;
+}
+
+static int connectUnix(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void raiseFileLimit()
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void report(const Options &opt, VirtualController *vcs, uint64_t elapsed,
+    uint64_t genCpu, const Bridge *bridge, uint64_t bridgeCpu)
+{
+    uint64_t sent = 0, received = 0, backpressure = 0;
+    LatencyHistogram all;
+    std::vector<std::pair<uint64_t, unsigned> > p99;
+
+    for (unsigned i = 0; i < opt.controllers; ++i) {
+        VirtualController &vc = vcs[i];
+        sent += vc.sent;
+        received += vc.received;
+        backpressure += vc.backpressure;
+        if (vc.latency.count()) {
+            all.merge(vc.latency);
+            p99.push_back(std::make_pair(vc.latency.percentile(99), i));
+        }
+    }
+
+    double secs = elapsed / 1e9;
+    printf("controllers=%u rate=%uHz duration=%.2fs\n", opt.controllers, opt.rate, secs);
+    printf("sent=%llu (%.0f/s, target %u/s) backpressure=%llu\n",
+        (unsigned long long) sent, sent / secs, opt.controllers * opt.rate,
+        (unsigned long long) backpressure);
+    printf("generator cpu: %.0f ns/report\n", sent ? double(genCpu) / sent : 0.0);
+
+    if (!bridge)
+        return;
+
+    const Bridge::Counters &bc = bridge->counters();
+    printf("delivered=%llu (%.0f/s) syncs=%llu events=%llu lost=%llu late=%llu pings=%llu\n",
+        (unsigned long long) received, received / secs,
+        (unsigned long long) bc.syncs, (unsigned long long) bc.events,
+        (unsigned long long) bc.lost, (unsigned long long) bc.late,
+        (unsigned long long) bc.pings);
+    printf("bridge cpu: %.0f ns/report (%.1f%% of one core)\n",
+        bc.reports ? double(bridgeCpu) / bc.reports : 0.0, 100.0 * bridgeCpu / elapsed);
+    bridge->latency().print(stdout, "bridge decode-to-emit");
+    all.print(stdout, "send-to-emit, all controllers");
+
+    /*
+     * Same clock on both ends, so this should track send-to-emit; what's
+     * left over is pings waiting for our loop to notice them, which makes
+     * the two legs asymmetric exactly the way a busy base would.
+     */
+    bridge->endToEnd().print(stdout, "commit-to-emit via clock sync");
+
+    if (p99.empty())
+        return;
+    std::sort(p99.begin(), p99.end());
+    printf("per-controller p99: min=%.1fus median=%.1fus max=%.1fus\n",
+        p99.front().first / 1e3, p99[p99.size() / 2].first / 1e3, p99.back().first / 1e3);
+
+    printf("worst controllers:\n");
+    for (unsigned i = 0; i < 5 && i < p99.size(); ++i) {
+        const VirtualController &vc = vcs[p99[p99.size() - 1 - i].second];
+        char name[32];
+        snprintf(name, sizeof name, "  #%u", p99[p99.size() - 1 - i].second);
+        vc.latency.print(stdout, name);
+    }
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-c controllers] [-r hz] [-d seconds] [-l socket] [-S seed]\n"
+        "  -c N        virtual controllers (default 200, max %u in-process)\n"
+        "  -r hz       reports per second per controller (default 125)\n"
+        "  -d seconds  run time (default 10)\n"
+        "  -l socket   drive a running mcc-bridge instead of an in-process one\n"
+        "  -S seed     motion model seed\n",
+        argv0, Bridge::kMaxControllers);
+}
+
+int main(int argc, char **argv)
+{
+    Options opt = { 200, 125, 10, 0, 1 };
+
+    int c;
+    while ((c = getopt(argc, argv, "c:r:d:l:S:h")) != -1) {
+        switch (c) {
+            case 'c': opt.controllers = atoi(optarg); break;
+            case 'r': opt.rate = atoi(optarg); break;
+            case 'd': opt.seconds = atoi(optarg); break;
+            case 'l': opt.socketPath = optarg; break;
+            case 'S': opt.seed = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (!opt.controllers || !opt.rate ||
+        (!opt.socketPath && opt.controllers > Bridge::kMaxControllers)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    raiseFileLimit();
+    signal(SIGPIPE, SIG_IGN);
+
+    VirtualController *vcs = new VirtualController[opt.controllers];
+    Bridge *bridge = 0;
+
+    // Like the base's read handler, notice host messages as they arrive
+    int inboxes = epoll_create1(EPOLL_CLOEXEC);
+
+    if (!opt.socketPath) {
+        Bridge::Options bo;
+        memset(&bo, 0, sizeof bo);
+        bo.mode = JoystickOutput::OUT_NULL;
+        bo.name = "MCC Load";
+        bo.pingIntervalMS = 250;
+        bridge = new Bridge;
+        if (!bridge->init(bo))
+            return 1;
+        bridge->setObserver(onReport, vcs);
+    }
+
+    uint32_t seed = opt.seed * 2654435761u + 1;
+    for (unsigned i = 0; i < opt.controllers; ++i) {
+        VirtualController &vc = vcs[i];
+        memset(&vc.sample, 0, sizeof vc.sample);
+        vc.head = vc.tail = 0;
+        vc.pendingLen = 0;
+        vc.inboxFill = 0;
+        vc.echoID = 0;
+        vc.sequence = 0;
+        vc.sent = vc.received = vc.backpressure = 0;
+        vc.rng = xorshift(seed) | 1;
+        for (unsigned k = 0; k < 3; ++k)
+            vc.phase[k] = (xorshift(vc.rng) % 6283) / 1000.0f;
+        vc.speed = 0.5f + (xorshift(vc.rng) % 3000) / 1000.0f;
+
+        if (bridge) {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0) {
+                perror("socketpair");
+                return 1;
+            }
+            vc.fd = sv[0];
+            if (bridge->addStream(sv[1]) != int(i)) {
+                fprintf(stderr, "mcc-loadgen: bridge refused controller %u\n", i);
+                return 1;
+            }
+        } else {
+            vc.fd = connectUnix(opt.socketPath);
+            if (vc.fd < 0) {
+                fprintf(stderr, "mcc-loadgen: %s: %s\n", opt.socketPath, strerror(errno));
+                return 1;
+            }
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(inboxes, EPOLL_CTL_ADD, vc.fd, &ev);
+    }
+
+    uint64_t bridgeCpu = 0;
+    std::thread loop;
+    if (bridge)
+        loop = std::thread([&] { bridge->run(); bridgeCpu = threadCpuNS(); });
+
+    // Stagger the controllers evenly over one period
+    uint64_t period = 1000000000ull / opt.rate;
+    uint64_t start = nowNS();
+    uint64_t end = start + uint64_t(opt.seconds) * 1000000000ull;
+    for (unsigned i = 0; i < opt.controllers; ++i)
+        vcs[i].next = start + period * i / opt.controllers;
+
+    uint64_t cpuStart = threadCpuNS();
+    uint64_t now;
+    while ((now = nowNS()) < end) {
+        struct epoll_event ready[64];
+        int n = epoll_wait(inboxes, ready, 64, 0);
+        for (int i = 0; i < n; ++i)
+            readMessages(vcs[ready[i].data.u32], now);
+
+        uint64_t soonest = end;
+        for (unsigned i = 0; i < opt.controllers; ++i) {
+            VirtualController &vc = vcs[i];
+            while (vc.next <= now) {
+                sendReport(vc, now, (now - start) / 1e9, bridge != 0);
+                vc.next += period;
+            }
+            soonest = std::min(soonest, vc.next);
+        }
+        now = nowNS();
+        if (soonest > now) {
+            struct timespec ts = { 0, long(soonest - now) };
+            nanosleep(&ts, 0);
+        }
+    }
+    uint64_t genCpu = threadCpuNS() - cpuStart;
+
+    // Closing our ends lets the bridge drain and fall out of run()
+    for (unsigned i = 0; i < opt.controllers; ++i)
+        close(vcs[i].fd);
+    close(inboxes);
+    if (bridge)
+        loop.join();
+
+    report(opt, vcs, nowNS() - start, genCpu, bridge, bridgeCpu);
+    delete bridge;
+    delete[] vcs;
+    return 0;
+}
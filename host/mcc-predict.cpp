@@ -0,0 +1,261 @@
+/*
+ * mcc-predict: replay a recorded report stream through the axis predictor
+ * (predictor.h) and measure what it buys.
+ *
+ * The capture is the same frame stream mcc-bridge -f reads, e.g. saved
+ * with tee on its way in. Joystick reports carrying base timestamps are
+ * the ground truth: between two reports an axis is taken to move in a
+ * straight line. For each horizon H the predictor runs over the whole
+ * trace, and we report:
+ *
+ *   lead       How far ahead of the raw reports the predicted ones are:
+ *              the shift L that best lines the predicted stream up with
+ *              the truth at t + L. This is the perceived latency saved.
+ *   err        |predicted - truth at t + H|, in high-res counts
+ *   hold err   The same for the raw value: the error at that latency
+ *              without prediction, for comparison
+ *
+ * Only axes that actually move in the trace are counted.
+ *
+ *   mcc-predict capture.bin
+ *   mcc-predict -H 0,8,16,24 -E 128 capture.bin
+ */
+
+#include "predictor.h"
+
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct TracePoint {
+    int64_t tUS;                // Unwrapped base time
+    ReportState state;
+};
+
+struct Errors {
+    std::vector<float> predicted;
+    std::vector<float> held;
+};
+
+static const unsigned kMaxHorizons = 16;
+static const unsigned kDefaultLead = 128;
+static const int kMinRange = 16;        // Counts an axis must span to be counted
+static const unsigned kLeadStepUS = 250;
+
+static bool load(const char *path, std::vector<TracePoint> &trace, unsigned &skipped)
+{
+    FILE *f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    uint8_t frame[REPORT_FRAME_SIZE];
+    bool haveLast = false;
+    uint32_t lastRaw = 0;
+    int64_t t = 0;
+    skipped = 0;
+
+    while (fread(frame, sizeof frame, 1, f) == 1) {
+        TracePoint p;
+        if (frame[0] != 0) {
+            skipped++;
+            continue;
+        }
+        decodeReport(frame + 1, p.state);
+        if (p.state.format < REPORT_FORMAT_SEQUENCED || p.state.mode != REPORT_MODE_JOYSTICK) {
+            skipped++;
+            continue;
+        }
+
+        uint32_t raw = p.state.timestampUS();
+        if (haveLast) {
+            uint32_t dt = (raw + AxisPredictor::kWrapUS - lastRaw) % AxisPredictor::kWrapUS;
+            if (dt == 0 || dt > AxisPredictor::kWrapUS / 2) {
+                // Duplicate or late; the truth has to move forward
+                skipped++;
+                continue;
+            }
+            t += dt;
+        }
+        haveLast = true;
+        lastRaw = raw;
+        p.tUS = t;
+        trace.push_back(p);
+    }
+
+    if (f != stdin)
+        fclose(f);
+    return true;
+}
+
+// The axis at time t, linear between reports; false past the end
+static bool truth(const std::vector<TracePoint> &trace, unsigned axis, int64_t t, float &value)
+{
+    if (t > trace.back().tUS)
+        return false;
+
+    auto after = std::lower_bound(trace.begin(), trace.end(), t,
+        [](const TracePoint &p, int64_t v) { return p.tUS < v; });
+    if (after == trace.begin() || after->tUS == t) {
+        value = after->state.hires[axis];
+        return true;
+    }
+
+    auto before = after - 1;
+    float f = float(t - before->tUS) / float(after->tUS - before->tUS);
+    value = before->state.hires[axis] + f * (after->state.hires[axis] - before->state.hires[axis]);
+    return true;
+}
+
+static float percentile(std::vector<float> &v, double p)
+{
+    if (v.empty())
+        return 0;
+    size_t i = size_t(p / 100 * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+static float mean(const std::vector<float> &v)
+{
+    double sum = 0;
+    for (float x : v)
+        sum += x;
+    return v.empty() ? 0 : float(sum / v.size());
+}
+
+// Mean distance from the predicted stream to the truth shifted by leadUS
+static double alignment(const std::vector<TracePoint> &trace, const std::vector<int16_t> &predicted,
+    const bool *active, int64_t leadUS)
+{
+    double sum = 0;
+    unsigned n = 0;
+    for (size_t i = 0; i < trace.size(); ++i)
+        for (unsigned a = 0; a < REPORT_NUM_AXES; ++a) {
+            float v;
+            if (active[a] && truth(trace, a, trace[i].tUS + leadUS, v)) {
+                sum += fabs(predicted[i * REPORT_NUM_AXES + a] - v);
+                n++;
+            }
+        }
+    return n ? sum / n : 0;
+}
+
+static void evaluate(const std::vector<TracePoint> &trace, const bool *active,
+    unsigned horizonMS, unsigned maxLead)
+{
+    AxisPredictor predictor;
+    predictor.configure(horizonMS * 1000, maxLead);
+
+    std::vector<int16_t> predicted(trace.size() * REPORT_NUM_AXES);
+    Errors e;
+
+    for (size_t i = 0; i < trace.size(); ++i) {
+        ReportState s = trace[i].state;
+        predictor.apply(s, s.timestampUS());
+
+        for (unsigned a = 0; a < REPORT_NUM_AXES; ++a) {
+            predicted[i * REPORT_NUM_AXES + a] = s.hires[a];
+
+            float v;
+            if (!active[a] || !truth(trace, a, trace[i].tUS + horizonMS * 1000, v))
+                continue;
+            e.predicted.push_back(fabsf(s.hires[a] - v));
+            e.held.push_back(fabsf(trace[i].state.hires[a] - v));
+        }
+    }
+
+    // The best-aligned shift, searched out to twice the horizon
+    int64_t bestLead = 0;
+    double bestCost = alignment(trace, predicted, active, 0);
+    for (int64_t lead = kLeadStepUS; lead <= int64_t(horizonMS) * 2000; lead += kLeadStepUS) {
+        double cost = alignment(trace, predicted, active, lead);
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestLead = lead;
+        }
+    }
+
+    printf("%4u ms %7.2f ms %9.1f %8.1f %8.1f %10.1f %9.1f\n",
+        horizonMS, bestLead / 1000.0,
+        mean(e.predicted), percentile(e.predicted, 99), percentile(e.predicted, 100),
+        mean(e.held), percentile(e.held, 99));
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-H ms,ms,...] [-E counts] capture\n"
+        "  -H ms,...   horizons to try (default 0,8,16,24,32)\n"
+        "  -E counts   largest correction, the error bound (default %u)\n",
+        argv0, kDefaultLead);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned horizons[kMaxHorizons] = { 0, 8, 16, 24, 32 };
+    unsigned numHorizons = 5;
+    unsigned maxLead = kDefaultLead;
+
+    int c;
+    while ((c = getopt(argc, argv, "H:E:h")) != -1) {
+        switch (c) {
+            case 'H': {
+                numHorizons = 0;
+                for (char *s = optarg; *s && numHorizons < kMaxHorizons; ) {
+                    horizons[numHorizons++] = strtoul(s, &s, 10);
+                    if (*s == ',')
+                        s++;
+                    else if (*s) {
+                        usage(argv[0]);
+                        return 2;
+                    }
+                }
+                break;
+            }
+            case 'E': maxLead = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<TracePoint> trace;
+    unsigned skipped;
+    if (!load(argv[optind], trace, skipped))
+        return 1;
+    if (trace.size() < 2) {
+        fprintf(stderr, "mcc-predict: no timestamped joystick reports in %s\n", argv[optind]);
+        return 1;
+    }
+
+    bool active[REPORT_NUM_AXES];
+    unsigned numActive = 0;
+    for (unsigned a = 0; a < REPORT_NUM_AXES; ++a) {
+        int lo = trace[0].state.hires[a], hi = lo;
+        for (const TracePoint &p : trace) {
+            lo = std::min<int>(lo, p.state.hires[a]);
+            hi = std::max<int>(hi, p.state.hires[a]);
+        }
+        active[a] = hi - lo >= kMinRange;
+        numActive += active[a];
+    }
+
+    double seconds = trace.back().tUS / 1e6;
+    printf("%zu reports over %.1f s (%.0f/s), %u skipped, %u moving axes, error bound %u counts\n",
+        trace.size(), seconds, seconds > 0 ? trace.size() / seconds : 0, skipped, numActive, maxLead);
+    if (!numActive)
+        return 0;
+
+    printf("horizon     lead  err mean  err p99  err max  hold mean  hold p99\n");
+    for (unsigned i = 0; i < numHorizons; ++i)
+        evaluate(trace, active, horizons[i], maxLead);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Short-horizon prediction of joystick axes, to hide some of the link.
+ *
+ * A report shows where the cubes were when the base committed it, and the
+ * game sees it a link delay later; with a 1-deep queue and RF jitter that
+ * delay varies from report to report, so a smooth tilt arrives as uneven
+ * steps. The predictor moves each high-res axis on along its own recent
+ * velocity to where it should be horizonUS after the commit.
+ *
+ * Velocity comes from consecutive reports' base timestamps, not their
+ * arrival times, so jitter on the link doesn't show up as speed. It is
+ * smoothed with a one-pole filter, restarted when the axis turns round
+ * (overshooting a reversal is the most visible mistake a predictor makes),
+ * and forgotten across a gap longer than kMaxGapUS.
+ *
+ * The error is bounded: a predicted value is never more than maxLead
+ * counts from the reported one, and never outside the axis range. With
+ * maxLead = 0 the predictor passes reports through untouched.
+ *
+ * Joystick mode only; mouse reports are relative counts already.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define MCC_HOST
+#include "../report.h"
+
+class AxisPredictor {
+public:
+    static const uint32_t kMaxGapUS = 50000;
+    static const uint32_t kWrapUS = 65536 * 1000;   // timestampUS()
+
+    AxisPredictor() : horizonUS(0), maxLead(0) { reset(); }
+
+    void configure(unsigned horizon, unsigned lead)
+    {
+        horizonUS = horizon;
+        maxLead = lead;
+        reset();
+    }
+
+    bool enabled() const { return horizonUS && maxLead; }
+
+    void reset()
+    {
+        memset(last, 0, sizeof last);
+        memset(velocity, 0, sizeof velocity);
+        haveLast = false;
+        lastUS = 0;
+    }
+
+    /*
+     * Replace s.hires[] with the prediction for horizonUS after the
+     * report's timestamp. Call for every report in arrival order; tUS is
+     * s.timestampUS() for formats that have one.
+     */
+    void apply(ReportState &s, uint32_t tUS)
+    {
+        if (!enabled() || s.mode != REPORT_MODE_JOYSTICK)
+            return;
+
+        uint32_t dt = haveLast ? (tUS + kWrapUS - lastUS) % kWrapUS : 0;
+        if (dt > kMaxGapUS) {
+            // Stale, or late and out of order; start again from here
+            reset();
+            dt = 0;
+        }
+
+        for (unsigned i = 0; i < REPORT_NUM_AXES; ++i) {
+            int x = s.hires[i];
+
+            if (dt) {
+                float raw = float(x - last[i]) / float(dt);
+                if (raw * velocity[i] < 0)
+                    velocity[i] = 0;
+                velocity[i] += kSmoothing * (raw - velocity[i]);
+            }
+            last[i] = x;
+
+            float lead = velocity[i] * float(horizonUS);
+            float limit = float(maxLead);
+            lead = lead > limit ? limit : lead < -limit ? -limit : lead;
+
+            int p = x + int(lead + (lead < 0 ? -0.5f : 0.5f));
+            s.hires[i] = int16_t(p > REPORT_HIRES_MAX ? REPORT_HIRES_MAX
+                : p < -REPORT_HIRES_MAX - 1 ? -REPORT_HIRES_MAX - 1 : p);
+        }
+
+        if (dt || !haveLast)
+            lastUS = tUS;
+        haveLast = true;
+    }
+
+private:
+    static constexpr float kSmoothing = 0.5f;
+
+    unsigned horizonUS;
+    unsigned maxLead;           // Counts; the error bound
+
+    int last[REPORT_NUM_AXES];
+    float velocity[REPORT_NUM_AXES];    // Counts per microsecond
+    bool haveLast;
+    uint32_t lastUS;
+};
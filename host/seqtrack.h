@@ -0,0 +1,146 @@
+/*
+ * Per-controller loss, reorder and jitter tracking from the sequence
+ * number and timestamp in REPORT_FORMAT_SEQUENCED reports.
+ *
+ * Sequence numbers are 8 bits, so a forward jump of less than half the
+ * space is read as loss, and a number behind the newest one as a late
+ * (reordered) report, or a duplicate if it was already seen; the last
+ * kHistory numbers are remembered to tell the two apart. Jitter is the
+ * RFC 3550 interarrival estimate: how much the spacing of arrivals differs
+ * from the spacing of the base's timestamps, smoothed over 16 reports.
+ *
+ * A restarted base starts its sequence and its clock again, and its new
+ * numbers can land anywhere relative to the old ones. We notice from the
+ * timestamp: while reports keep flowing, the base's clock can't advance
+ * further than ours did (a report can be delayed, never early), and only
+ * a reordered report, a few milliseconds old, goes backwards. Beyond
+ * kRestartSlackMS either way it's a restart. A long silence hides that,
+ * so runs of reports that are all behind, or jumps too large to be loss,
+ * resync as well.
+ */
+
+#pragma once
+#include <stdint.h>
+
+class SequenceTracker {
+public:
+    struct Counters {
+        uint64_t received;
+        uint64_t lost;          // Sequence numbers never seen
+        uint64_t late;          // Arrived behind a newer report
+        uint64_t duplicates;    // Seen before
+        uint64_t resyncs;       // Base restarted, or a jump too large to be loss
+    };
+
+    SequenceTracker() { reset(); }
+
+    void reset()
+    {
+        started = false;
+        jitterNS = 0;
+        history = 0;
+        behindRun = 0;
+        count.received = count.lost = count.late = count.duplicates = count.resyncs = 0;
+    }
+
+    void onReport(uint8_t seq, uint16_t timestampMS, uint64_t arrivalNS)
+    {
+        count.received++;
+
+        if (!started) {
+            started = true;
+            restart(seq, timestampMS, arrivalNS);
+            return;
+        }
+
+        if (clockJumped(timestampMS, arrivalNS)) {
+            count.resyncs++;
+            restart(seq, timestampMS, arrivalNS);
+            return;
+        }
+
+        int8_t delta = int8_t(seq - expected);
+        if (delta < 0) {
+            unsigned age = unsigned(-delta) - 1;       // 0 = the newest seen
+            if (age < kHistory && (history >> age) & 1) {
+                count.duplicates++;
+            } else if (age < kHistory) {
+                // The gap we counted for it was only a delay
+                count.late++;
+                history |= uint64_t(1) << age;
+                if (count.lost)
+                    count.lost--;
+            } else {
+                count.late++;
+            }
+
+            if (++behindRun >= kMaxBehind) {
+                count.resyncs++;
+                restart(seq, timestampMS, arrivalNS);
+            }
+            return;
+        }
+        behindRun = 0;
+
+        if (delta > kMaxGap) {
+            count.resyncs++;
+            restart(seq, timestampMS, arrivalNS);
+            return;
+        }
+        count.lost += delta;
+        expected = seq + 1;
+        history = delta + 1 < int(kHistory) ? (history << (delta + 1)) | 1 : 1;
+
+        // Base timestamps wrap at 16 bits of milliseconds
+        int64_t sent = int64_t(uint16_t(timestampMS - lastStamp)) * 1000000;
+        int64_t arrived = int64_t(arrivalNS - lastArrival);
+        int64_t d = arrived - sent;
+        if (d < 0)
+            d = -d;
+        jitterNS += (d - jitterNS) / 16;
+
+        lastArrival = arrivalNS;
+        lastStamp = timestampMS;
+    }
+
+    const Counters &counters() const { return count; }
+    uint64_t jitter() const { return jitterNS; }
+
+private:
+    // Forward jumps beyond this are treated as a restart, not loss
+    static const int kMaxGap = 100;
+    // Consecutive reports behind the newest before we believe them instead
+    static const unsigned kMaxBehind = 8;
+    static const unsigned kHistory = 64;
+    static const int64_t kRestartSlackMS = 1000;
+    // Beyond this much silence the 16-bit timestamp can't be compared
+    static const int64_t kMaxCompareMS = 30000;
+
+    bool started;
+    uint8_t expected;
+    uint64_t history;           // Bit N: sequence expected - 1 - N was seen
+    unsigned behindRun;
+    uint16_t lastStamp;
+    uint64_t lastArrival;
+    int64_t jitterNS;
+    Counters count;
+
+    void restart(uint8_t seq, uint16_t timestampMS, uint64_t arrivalNS)
+    {
+        expected = seq + 1;
+        history = 1;
+        behindRun = 0;
+        lastArrival = arrivalNS;
+        lastStamp = timestampMS;
+    }
+
+    bool clockJumped(uint16_t timestampMS, uint64_t arrivalNS) const
+    {
+        int64_t arrivedMS = int64_t(arrivalNS - lastArrival) / 1000000;
+        if (arrivedMS > kMaxCompareMS)
+            return false;
+
+        int64_t advancedMS = int16_t(timestampMS - lastStamp);
+        return advancedMS > arrivedMS + kRestartSlackMS || advancedMS < -kRestartSlackMS;
+    }
+};
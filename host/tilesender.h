@@ -0,0 +1,188 @@
+/*
+ * Host side of HOST_MSG_TILES: keeps one cube's screen in step with an
+ * image, a packet at a time.
+ *
+ * The sender holds the image it wants on screen and a shadow of what the
+ * base has been sent. next() encodes the first stretch of differences that
+ * fits one packet: runs over a dictionary of at most TILES_MAX_DICT words,
+ * gathered greedily in screen order, with skip runs over tiles that are
+ * already right. The shadow is updated as the packet is built; the caller
+ * keeps the packet and resends it until it is echoed, which is safe since
+ * every message is absolute.
+ *
+ * Until the first packet the screen is unknown, so that one carries
+ * TILES_CLEAR and the shadow starts from blank. An icon on a blank screen
+ * usually goes in one or two packets.
+ *
+ * Shared with the host tools; no SDK dependency.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define MCC_HOST
+#include "../report.h"
+
+class TileSender {
+public:
+    static const unsigned kTiles = TILES_GRID * TILES_GRID;
+
+    TileSender() { reset(); }
+
+    // The base has forgotten us (new connection, or a restart)
+    void reset()
+    {
+        memset(target, 0, sizeof target);
+        memset(shadow, 0, sizeof shadow);
+        active = false;
+        known = false;
+        releasing = false;
+        pushedNS = 0;
+    }
+
+    /*
+     * Show image (kTiles words, row-major; the border ring is ignored) as
+     * soon as possible. Replaces whatever was pushed before.
+     */
+    void push(const uint16_t *image, uint64_t nowNS)
+    {
+        memcpy(target, image, sizeof target);
+        active = true;
+        releasing = false;
+        pushedNS = nowNS;
+    }
+
+    // Hand the screen back to the cube's status display
+    void release(uint64_t nowNS)
+    {
+        if (!active && !known)
+            return;
+        active = false;
+        releasing = true;
+        pushedNS = nowNS;
+    }
+
+    // Anything left to send
+    bool pending() const
+    {
+        if (releasing)
+            return true;
+        if (!active)
+            return false;
+        return !known || firstDifference(0) < kTiles;
+    }
+
+    // When the image now pending was pushed
+    uint64_t pushedAt() const { return pushedNS; }
+
+    /*
+     * Encode the next packet for role into body (TILES_BODY_SIZE bytes).
+     * Returns its length, or 0 if there's nothing to send; tiles is set to
+     * the number of tiles it writes.
+     */
+    unsigned next(uint8_t role, uint8_t *body, unsigned &tiles)
+    {
+        tiles = 0;
+        memset(body, 0, TILES_BODY_SIZE);
+        body[TILES_TARGET] = role;
+
+        if (releasing) {
+            releasing = false;
+            known = false;
+            body[TILES_FLAGS] = TILES_RELEASE;
+            return TILES_DICT;
+        }
+        if (!active)
+            return 0;
+
+        if (!known) {
+            for (unsigned i = 0; i < kTiles; ++i)
+                shadow[i] = TILE_BLANK;
+            known = true;
+            body[TILES_FLAGS] = TILES_CLEAR;
+        }
+
+        unsigned start = firstDifference(0);
+        if (start == kTiles)
+            return body[TILES_FLAGS] ? TILES_DICT : 0;
+        body[TILES_START] = start;
+
+        uint16_t dict[TILES_MAX_DICT];
+        uint8_t runs[TILES_BODY_SIZE];
+        unsigned numDict = 0, numRuns = 0;
+        unsigned runLength = 0;
+
+        for (unsigned pos = start; pos < kTiles; ++pos) {
+            unsigned current = numRuns ? runs[numRuns - 1] >> 6 : TILES_SKIP;
+            unsigned code;
+
+            if (tileOnBorder(pos)) {
+                // Never drawn; any run can cross it
+                code = current;
+            } else if (target[pos] == shadow[pos]) {
+                bool same = current != TILES_SKIP && dict[current] == target[pos];
+                code = same ? current : TILES_SKIP;
+            } else {
+                for (code = 0; code < numDict && dict[code] != target[pos]; ++code);
+                if (code == numDict) {
+                    if (numDict == TILES_MAX_DICT || !fits(numDict + 1, numRuns + 1))
+                        break;
+                    dict[numDict++] = target[pos];
+                }
+            }
+
+            if (numRuns && code == current && runLength < TILES_MAX_RUN) {
+                runLength++;
+            } else {
+                if (numRuns)
+                    runs[numRuns - 1] |= runLength - 1;
+                if (!fits(numDict, numRuns + 1))
+                    break;
+                runs[numRuns++] = code << 6;
+                runLength = 1;
+            }
+
+            if (code != TILES_SKIP && !tileOnBorder(pos)) {
+                shadow[pos] = dict[code];
+                tiles++;
+            }
+        }
+        if (numRuns)
+            runs[numRuns - 1] |= runLength - 1;
+
+        // Whatever follows the last run is left alone anyway
+        while (numRuns && (runs[numRuns - 1] >> 6) == TILES_SKIP)
+            numRuns--;
+
+        body[TILES_COUNTS] = numDict | (numRuns << 2);
+        uint8_t *p = body + TILES_DICT;
+        for (unsigned i = 0; i < numDict; ++i) {
+            *p++ = uint8_t(dict[i]);
+            *p++ = uint8_t(dict[i] >> 8);
+        }
+        memcpy(p, runs, numRuns);
+        return unsigned(p - body) + numRuns;
+    }
+
+private:
+    uint16_t target[kTiles];
+    uint16_t shadow[kTiles];    // What the base has been sent, if known
+    bool active;                // Showing target, as opposed to released
+    bool known;                 // shadow is valid
+    bool releasing;
+    uint64_t pushedNS;
+
+    static bool fits(unsigned numDict, unsigned numRuns)
+    {
+        return TILES_DICT + 2 * numDict + numRuns <= TILES_BODY_SIZE;
+    }
+
+    unsigned firstDifference(unsigned from) const
+    {
+        for (unsigned pos = from; pos < kTiles; ++pos)
+            if (!tileOnBorder(pos) && target[pos] != shadow[pos])
+                return pos;
+        return kTiles;
+    }
+};
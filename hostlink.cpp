@@ -0,0 +1,73 @@
+/*
+ * Messages from the host, and the echo that acknowledges them.
+ */
+
+#include "hostlink.h"
+#include "session.h"
+#include "mouse.h"
+#include "feedback.h"
+#include "tiles.h"
+
+HostLink hostLink;
+
+void HostLink::init()
+{
+    bzero(*this);
+}
+
+bool HostLink::onMessage(const BluetoothPacket &packet, SystemTime now)
+{
+    uint8_t id = packet.size() > HOST_MSG_ID ? packet.bytes()[HOST_MSG_ID] : 0;
+
+    switch (packet.type()) {
+    case HOST_MSG_PING:
+        break;
+    case HOST_MSG_PROFILE:
+        onProfile(packet);
+        break;
+    case HOST_MSG_FEEDBACK:
+        // Echoed once the frame that shows it is rendered, not now
+        feedback.onMessage(packet, id, now);
+        return true;
+    case HOST_MSG_TILES:
+        hostTiles.onMessage(packet);
+        break;
+    default:
+        numUnknown++;
+        return false;
+    }
+
+    if (id)
+        acknowledge(id, now);
+    return true;
+}
+
+void HostLink::acknowledge(uint8_t id, SystemTime at)
+{
+    /*
+     * Only the newest message is echoed. The host treats an id that never
+     * comes back as lost, which is the right answer for a ping anyway: a
+     * sample that waited behind another one has a stretched round trip.
+     */
+
+    if (pendingID)
+        numOverwritten++;
+    pendingID = id;
+    receivedAt = at;
+    numMessages++;
+}
+
+void HostLink::onProfile(const BluetoothPacket &packet)
+{
+    /*
+     * Still echoed when rejected: the echo says the message arrived, and
+     * the mode in the reports that follow says what the base made of it.
+     */
+
+    unsigned mode = packet.size() > HOST_MSG_BODY ? packet.bytes()[HOST_MSG_BODY] : REPORT_MODE_COUNT;
+    if (mode >= REPORT_MODE_COUNT || (mode == REPORT_MODE_MOUSE && !mouse.available())) {
+        numRejected++;
+        return;
+    }
+    session.setMode(mode);
+}
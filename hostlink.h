@@ -0,0 +1,67 @@
+/*
+ * Messages from the host, and the echo that acknowledges them.
+ *
+ * The host sends small typed packets down the same pipe the reports go up
+ * (see report.h). Whatever the message, the base remembers its id and the
+ * time it arrived, and the next report carries the id back along with how
+ * long the base held it. That is all the host needs to measure round-trip
+ * time and the offset between the two clocks, so reports can be mapped
+ * into host time. Later message types reuse the same echo as their ack;
+ * HOST_MSG_FEEDBACK's is released by feedback.h once its effect is on screen.
+ */
+
+#pragma once
+#include "app.h"
+
+class HostLink {
+public:
+    void init();
+
+    /*
+     * Called from the read handler for every packet from the host. Returns
+     * false for packets that aren't HOST_MSG_* messages.
+     */
+    bool onMessage(const BluetoothPacket &packet, SystemTime now);
+
+    /*
+     * Echo id in the next report, holding since at. onMessage() does this
+     * itself for everything but feedback.
+     */
+    void acknowledge(uint8_t id, SystemTime at);
+
+    // An echo is waiting; the write path sends a report even if redundant
+    bool echoPending() const { return pendingID != 0; }
+
+    /*
+     * Put the pending echo, if any, into a report that has already been
+     * stamped and is about to be committed.
+     */
+    void stamp(uint8_t *bytes, SystemTime now)
+    {
+        if (!pendingID)
+            return;
+        stampEcho(bytes, pendingID, (now - receivedAt).nanoseconds() / 1000);
+        pendingID = 0;
+        numEchoed++;
+    }
+
+    unsigned messages() const { return numMessages; }
+    unsigned echoed() const { return numEchoed; }
+    unsigned overwritten() const { return numOverwritten; }
+    unsigned unknown() const { return numUnknown; }
+    unsigned rejected() const { return numRejected; }
+
+private:
+    uint8_t pendingID;
+    SystemTime receivedAt;
+
+    unsigned numMessages;
+    unsigned numEchoed;
+    unsigned numOverwritten;    // A second message arrived before the echo went out
+    unsigned numUnknown;
+    unsigned numRejected;       // Known type, but a body we can't act on
+
+    void onProfile(const BluetoothPacket &packet);
+};
+
+extern HostLink hostLink;
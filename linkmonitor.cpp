@@ -0,0 +1,76 @@
+/*
+ * Link health monitor.
+ */
+
+#include "linkmonitor.h"
+
+LinkMonitor linkMonitor;
+
+void LinkMonitor::init()
+{
+    bzero(*this);
+    current = LEVEL_FULL;
+}
+
+const char *LinkMonitor::levelName(Level l)
+{
+    switch (l) {
+        case LEVEL_FULL:            return "full";
+        case LEVEL_REDUCED_RATE:    return "rate";
+        case LEVEL_COARSE:          return "coarse";
+        case LEVEL_CHANGE_ONLY:     return "change";
+        default:                    return "?";
+    }
+}
+
+unsigned LinkMonitor::expectedTx() const
+{
+    // Change-only sending makes the rate depend on the player, not the link
+    if (current >= LEVEL_CHANGE_ONLY)
+        return 0;
+    if (current >= LEVEL_REDUCED_RATE && baselineTx > kReducedRateHz)
+        return kReducedRateHz;
+    return baselineTx;
+}
+
+void LinkMonitor::update(const Stats::Snapshot &s)
+{
+    if (!Bluetooth::isConnected()) {
+        badPeriods = goodPeriods = 0;
+        return;
+    }
+
+    // Learn what an unthrottled, drop-free link can do
+    if (current == LEVEL_FULL && s.dropPerSec <= kDropLow)
+        baselineTx = max(s.txPerSec, baselineTx - baselineTx / 8);
+
+    unsigned expected = expectedTx();
+    bool congested = s.dropPerSec >= kDropHigh
+        || s.txPerSec * 100 < expected * kThroughputLowPct;
+    bool healthy = s.dropPerSec <= kDropLow
+        && s.txPerSec * 100 >= expected * kThroughputOkPct;
+
+    if (congested) {
+        goodPeriods = 0;
+        if (++badPeriods >= kStepDownPeriods && current + 1 < NUM_LEVELS) {
+            setLevel(Level(current + 1), s);
+            badPeriods = 0;
+        }
+    } else if (healthy) {
+        badPeriods = 0;
+        if (++goodPeriods >= kStepUpPeriods && current > LEVEL_FULL) {
+            setLevel(Level(current - 1), s);
+            goodPeriods = 0;
+        }
+    } else {
+        // In between: hold the current level
+        badPeriods = goodPeriods = 0;
+    }
+}
+
+void LinkMonitor::setLevel(Level l, const Stats::Snapshot &s)
+{
+    MCC_LOG(LOG_CAT_LINK, LOG_LEVEL_INFO, "Link: %s -> %s (tx=%d/s expected=%d/s drop=%d/s)\n",
+        levelName(current), levelName(l), s.txPerSec, expectedTx(), s.dropPerSec);
+    current = l;
+}
@@ -0,0 +1,123 @@
+/*
+ * Link health monitor.
+ *
+ * Once per Stats capture, we look at how the Bluetooth link did over the
+ * last period and step the transmit policy down when it looks congested,
+ * or back up once it has been healthy for a while. Each level keeps the
+ * restrictions of the levels above it:
+ *
+ *   LEVEL_FULL          Send a report whenever the pipe has room
+ *   LEVEL_REDUCED_RATE  Cap the report rate
+ *   LEVEL_COARSE        Also quantize the axes, so jitter stops producing new reports
+ *   LEVEL_CHANGE_ONLY   Also skip reports identical to the last one sent (with a keepalive)
+ *
+ * onWriteAvailable() consults readyToSend() / isRedundant() on every packet,
+ * so these have to stay trivial.
+ */
+
+#pragma once
+#include "app.h"
+#include "stats.h"
+
+class LinkMonitor {
+public:
+    enum Level {
+        LEVEL_FULL,
+        LEVEL_REDUCED_RATE,
+        LEVEL_COARSE,
+        LEVEL_CHANGE_ONLY,
+        NUM_LEVELS
+    };
+
+    // Report bytes compared for change-only sending: 4 axes + 2 button bytes...
+    static const unsigned kReportBytes = 6;
+    // ...and the high-res lanes, in REPORT_FORMAT_HIRES reports
+    static const unsigned kHiresBytes = REPORT_SIZE - REPORT_HIRES;
+
+    // Congested if we drop this many packets per second...
+    static const unsigned kDropHigh = 8;
+    // ...or deliver less than this percentage of the rate we're aiming for
+    static const unsigned kThroughputLowPct = 60;
+
+    // Healthy only when both are comfortably better
+    static const unsigned kDropLow = 1;
+    static const unsigned kThroughputOkPct = 85;
+
+    // Hysteresis, in consecutive capture periods
+    static const unsigned kStepDownPeriods = 2;
+    static const unsigned kStepUpPeriods = 5;
+
+    static const unsigned kReducedRateHz = 30;
+    static const unsigned kCoarseMask = 0xF8;
+    static const unsigned kCoarseLaneMask = kCoarseMask << 4;
+    static const unsigned kKeepaliveMS = 250;
+
+    void init();
+    void update(const Stats::Snapshot &s);
+
+    Level level() const { return current; }
+    static const char *levelName(Level l);
+
+    bool readyToSend(SystemTime now) const
+    {
+        return current < LEVEL_REDUCED_RATE || !lastSent.isValid()
+            || (now - lastSent) >= TimeDelta::hz(kReducedRateHz);
+    }
+
+    void quantizeAxes(uint8_t *bytes) const
+    {
+        if (current < LEVEL_COARSE)
+            return;
+
+        // Round toward negative infinity; the sign bit survives the mask
+        for (unsigned i = 0; i < 4; ++i)
+            bytes[i] &= kCoarseMask;
+
+        // The same steps on the lanes, so both views of an axis agree
+        if (hasHires(bytes)) {
+            uint8_t *p = bytes + REPORT_HIRES;
+            for (unsigned i = 0; i < REPORT_NUM_AXES; i += 2, p += 3) {
+                unsigned lo = (p[0] | (p[1] << 8)) & kCoarseLaneMask;
+                unsigned hi = ((p[1] >> 4) | (p[2] << 4)) & kCoarseLaneMask;
+                p[0] = uint8_t(lo);
+                p[1] = uint8_t((lo >> 8) | (hi << 4));
+                p[2] = uint8_t(hi >> 4);
+            }
+        }
+    }
+
+    // Sub-count motion only shows in the lanes, so they count as a change too
+    bool isRedundant(const uint8_t *bytes, SystemTime now) const
+    {
+        return current >= LEVEL_CHANGE_ONLY
+            && !memcmp8(bytes, lastReport, kReportBytes)
+            && (!hasHires(bytes) || !memcmp8(bytes + REPORT_HIRES, lastReport + kReportBytes, kHiresBytes))
+            && (now - lastSent) < TimeDelta::fromMillisec(kKeepaliveMS);
+    }
+
+    void onSent(const uint8_t *bytes, SystemTime now)
+    {
+        memcpy8(lastReport, bytes, kReportBytes);
+        memcpy8(lastReport + kReportBytes, bytes + REPORT_HIRES, kHiresBytes);
+        lastSent = now;
+    }
+
+private:
+    Level current;
+    unsigned badPeriods;
+    unsigned goodPeriods;
+    unsigned baselineTx;    // Best recent unthrottled packet rate
+
+    SystemTime lastSent;
+    uint8_t lastReport[kReportBytes + kHiresBytes];
+
+    static bool hasHires(const uint8_t *bytes)
+    {
+        return (bytes[REPORT_FORMAT] & REPORT_FORMAT_MASK) >= REPORT_FORMAT_HIRES;
+    }
+
+    unsigned expectedTx() const;
+    void setLevel(Level l, const Stats::Snapshot &s);
+};
+
+extern LinkMonitor linkMonitor;
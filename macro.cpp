@@ -0,0 +1,72 @@
+/*
+ * Turbo and combo macros, played on top of the mapped buttons.
+ */
+
+#include "macro.h"
+
+MacroEngine macros;
+
+void MacroEngine::init()
+{
+    bzero(*this);
+
+    for (unsigned i = 0; i < mappingNumMacros; ++i)
+        if (mappingMacros[i].consume)
+            consumed |= mappingMacros[i].trigger;
+}
+
+void MacroEngine::tick(SystemTime now)
+{
+    if (!mappingNumMacros)
+        return;
+
+    int32_t ms = 0;
+    if (lastTick.isValid()) {
+        unsigned dt = (now - lastTick).milliseconds();
+        ms = dt < kMaxTickMS ? dt : kMaxTickMS;
+    }
+    lastTick = now;
+    counters.ticks++;
+
+    unsigned out = 0;
+    for (unsigned i = 0; i < mappingNumMacros; ++i) {
+        const MacroConfig &m = mappingMacros[i];
+        State &s = states[i];
+
+        if (s.running) {
+            // A turbo lasts exactly as long as its trigger; a combo plays out
+            if (m.repeat && !(held & m.trigger))
+                s.running = false;
+            else
+                s.running = advance(m, s, ms);
+        } else if (m.repeat ? (held & m.trigger) : (pressed & m.trigger)) {
+            // The first step starts now; this tick's time belongs to before it
+            s.running = true;
+            s.step = 0;
+            s.leftMS = mappingMacroSteps[m.firstStep].ms;
+            counters.started++;
+        }
+
+        if (s.running)
+            out |= mappingMacroSteps[m.firstStep + s.step].buttons;
+    }
+
+    pressed = 0;
+    output = out;
+}
+
+// Move s on by ms; false once a combo has run out of steps
+bool MacroEngine::advance(const MacroConfig &m, State &s, int32_t ms)
+{
+    // Steps are at least MACRO_MIN_STEP_MS, so this loops only a few times
+    s.leftMS -= ms;
+    while (s.leftMS <= 0) {
+        if (++s.step == m.numSteps) {
+            if (!m.repeat)
+                return false;
+            s.step = 0;
+        }
+        s.leftMS += mappingMacroSteps[m.firstStep + s.step].ms;
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * Turbo and combo macros, played on top of the mapped buttons.
+ *
+ * mapping.lua declares them (see mapgen.lua): a turbo pulses a button at a
+ * fixed rate for as long as its rules hold, a combo plays a timed list of
+ * button states once per press of its trigger. Both compile to the same
+ * thing, a trigger button and a run of steps in mappingMacroSteps.
+ *
+ * The work is split between two cadences. Every report passes through
+ * apply(), which notes which triggers the mapping pressed and merges the
+ * current macro output into the button bytes; that is a couple of masks
+ * and no allocation. The timing lives in tick(), which the main loop calls
+ * once a frame next to System::paint(): it advances each running macro by
+ * the elapsed time and recomputes the output. So step edges land on frame
+ * boundaries, which is why mapgen.lua won't make a step shorter than
+ * MACRO_MIN_STEP_MS, and one tick touches at most MACRO_MAX macros and a
+ * bounded number of steps each.
+ *
+ * Triggers pressed and released between two ticks are latched by apply(),
+ * so even the shortest tap starts its combo.
+ */
+
+#pragma once
+#include "app.h"
+#include "mapping.h"
+
+class MacroEngine {
+public:
+    // Longest time one tick advances by; a stall doesn't skip whole steps
+    static const unsigned kMaxTickMS = 100;
+
+    struct Counters {
+        unsigned started;
+        unsigned ticks;
+    };
+
+    void init();
+
+    // From the main loop, once a frame
+    void tick(SystemTime now);
+
+    // From buildReport(), joystick mode: merge macro output into bytes[4..5]
+    void apply(uint8_t *bytes)
+    {
+        if (!mappingNumMacros)
+            return;
+
+        unsigned buttons = bytes[REPORT_BUTTONS_LO] | (bytes[REPORT_BUTTONS_HI] << 8);
+        pressed |= buttons & ~held;
+        held = buttons;
+
+        buttons = (buttons & ~consumed) | output;
+        bytes[REPORT_BUTTONS_LO] = buttons;
+        bytes[REPORT_BUTTONS_HI] = buttons >> 8;
+    }
+
+    const Counters &stats() const { return counters; }
+
+private:
+    struct State {
+        bool running;
+        uint8_t step;           // Into the macro's own steps
+        int32_t leftMS;         // Until the next step
+    };
+
+    State states[MACRO_MAX];
+    uint16_t held;              // Mapped buttons in the latest report
+    uint16_t pressed;           // Rising edges since the last tick
+    uint16_t consumed;          // Triggers kept out of the report
+    uint16_t output;            // Buttons the running macros hold
+    SystemTime lastTick;
+    Counters counters;
+
+    bool advance(const MacroConfig &m, State &s, int32_t ms);
+};
+
+extern MacroEngine macros;
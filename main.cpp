@@ -4,13 +4,26 @@
 
 #include <sifteo.h>
 #include "assets.gen.h"
+#include "app.h"
+#include "stats.h"
+#include "dashboard.h"
+#include "linkmonitor.h"
+#include "session.h"
+#include "advertise.h"
+#include "power.h"
+#include "mapping.h"
+#include "hostlink.h"
+#include "mouse.h"
+#include "highres.h"
+#include "aggregate.h"
+#include "calibrate.h"
+#include "macro.h"
+#include "scheduler.h"
+#include "feedback.h"
+#include "tiles.h"
 
 #include <sifteo/menu.h>
 using namespace Sifteo;
-///////////////
-static const unsigned numCubes = 3;
-static const CubeSet allCubes(0, numCubes);
-///////////////
 Metadata M = Metadata()
     .title("Bluetooth Tai")
     .package("com.Joyscube.sdk.bluetooth", "1.0")
@@ -30,16 +43,23 @@ BluetoothPipe <1,1> btPipe;
 BluetoothCounters btCounters;
 
 ///VideoBuffer vid;
-static VideoBuffer vid[numCubes];
+VideoBuffer vid[numDisplays];
 ///For onAccelChange
 static TiltShakeRecognizer motion[numCubes];
 
-void onCubeTouch(void *, unsigned);
 void onConnect();
 void onDisconnect();
 void onReadAvailable();
 void onWriteAvailable();
 void updatePacketCounts(int tx, int rx);
+void toggleDashboard();
+void drawConnectionState();
+
+// Whether a cube shows our own screens: it has a display, and the host hasn't taken it (tiles.h)
+static bool drawsStatus(unsigned id)
+{
+    return hasDisplay(id) && !hostTiles.owns(id);
+}
 /**
 * below added class SensorListener for neighbor 
 */
@@ -52,6 +72,14 @@ public:
         unsigned neighborRemove;
     } counters[numCubes];
 
+    // Accelerometer events as they arrive, and cube updates after coalescing
+    unsigned accelEvents;
+    unsigned accelProcessed;
+
+    // Tiles drawn for the neighbor display, and what full redraws would have cost
+    unsigned neighborTiles;
+    unsigned neighborFullTiles;
+
     void install()
     {
         Events::neighborAdd.set(&SensorListener::onNeighborAdd, this);
@@ -72,14 +100,39 @@ private:
     void onConnect(unsigned id)
     {
         CubeID cube(id);
-        uint64_t hwid = cube.hwID();
-
         bzero(counters[id]);
-        LOG("Cube %d connected\n", id);
+        MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_INFO, "Cube %d connected\n", id);
+
+        // A cube seen before starts with its stored bias; a new one learns it at rest
+        calibration.onConnect(id, cube.hwID());
+
+        motion[id].attach(id);
+        if (!hasDisplay(id))
+            return;
 
         vid[id].initMode(BG0_ROM);
         vid[id].attach(id);
-        motion[id].attach(id);
+        redraw(cube);
+    }
+
+public:
+    // The neighbor display in full, after something else drew over its indicators
+    void redrawNeighbors(CubeID cube)
+    {
+        if (!drawsStatus(cube))
+            return;
+        shown[cube].valid = false;
+        drawNeighbors(cube);
+    }
+
+    // Draw the cube's normal (non-dashboard) screen from scratch
+    void redraw(CubeID cube)
+    {
+        if (!drawsStatus(cube))
+            return;
+        shown[cube].valid = false;
+
+        uint64_t hwid = cube.hwID();
 
         // Draw the cube's identity
         String<128> str;
@@ -88,15 +141,20 @@ private:
         vid[cube].bg0rom.text(vec(1,2), str);
 
         // Draw initial state for all sensors
-        onAccelChange(cube);
+        updateAccel(cube);
         onBatteryChange(cube);
 //        onTouch(cube);
         drawNeighbors(cube);
     }
-	
+
+private:
     void onBatteryChange(unsigned id)
     {
         CubeID cube(id);
+        power.onBatteryChange(id);
+        if (dashboard.isActive() || !drawsStatus(id))
+            return;
+
         String<32> str;
         str << "bat:   " << FixedFP(cube.batteryLevel(), 1, 3) << "\n";
         vid[cube].bg0rom.text(vec(1,13), str);
@@ -104,7 +162,7 @@ private:
 	
     void onNeighborRemove(unsigned firstID, unsigned firstSide, unsigned secondID, unsigned secondSide)
     {
-        LOG("Neighbor Remove: %02x:%d - %02x:%d\n", firstID, firstSide, secondID, secondSide);
+        MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_DEBUG, "Neighbor Remove: %02x:%d - %02x:%d\n", firstID, firstSide, secondID, secondSide);
 		neighboring = false;
         if (firstID < arraysize(counters)) {
             counters[firstID].neighborRemove++;
@@ -118,7 +176,10 @@ private:
 
     void onNeighborAdd(unsigned firstID, unsigned firstSide, unsigned secondID, unsigned secondSide)
     {
-        LOG("Neighbor Add: %02x:%d - %02x:%d\n", firstID, firstSide, secondID, secondSide);
+        MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_DEBUG, "Neighbor Add: %02x:%d - %02x:%d\n", firstID, firstSide, secondID, secondSide);
+
+        if (Dashboard::isGesture(firstID, firstSide, secondID, secondSide))
+            toggleDashboard();
 
 		neighboring = true;
         if (firstID < arraysize(counters)) {
@@ -131,41 +192,144 @@ private:
         }
     }
 
+    /*
+     * What the neighbor display currently shows, so an event redraws only
+     * the side that changed (its id and indicator) and the counter line.
+     * A pairing gesture touches one side of each cube, so that's about a
+     * quarter of the tiles a full redraw would write.
+     */
+    struct NeighborView {
+        bool valid;                     // False until drawn in full
+        uint8_t id[NUM_SIDES];
+        unsigned add, remove;
+    } shown[numDisplays];
+
+    // Where each side's id and edge indicator are drawn, by Side
+    static const Int2 neighborIDPos[NUM_SIDES];
+    static const Int2 indicatorPos[NUM_SIDES];
+    static const Int2 indicatorSize[NUM_SIDES];
+    static const unsigned indicatorTiles = 4 * 14;
+
     void drawNeighbors(CubeID cube)
     {
-        Neighborhood nb(cube);
-
-        String<64> str;
-        str << "      "
-            << Hex(nb.neighborAt(TOP), 2) << "\n   "
-            << Hex(nb.neighborAt(LEFT), 2) << "    "
-            << Hex(nb.neighborAt(RIGHT), 2) << "\n      "
-            << Hex(nb.neighborAt(BOTTOM), 2) << "\n";
-
-        str << "   +" << counters[cube].neighborAdd
-            << ", -" << counters[cube].neighborRemove
-            << "\n\n";
+        if (dashboard.isActive() || !drawsStatus(cube))
+            return;
 
+        Neighborhood nb(cube);
+        NeighborView &v = shown[cube];
         BG0ROMDrawable &draw = vid[cube].bg0rom;
-        draw.text(vec(1,6), str);
+        const Counter &c = counters[cube];
+
+        // The edge indicators share the border with feedback effects
+        bool indicators = !feedback.covers(cube);
+
+        String<24> count;
+        count << "+" << c.neighborAdd << ", -" << c.neighborRemove;
+
+        // Three id lines, the counter line and its indent, and the indicators
+        unsigned fullTiles = 8 + 11 + 8 + 3 + count.size() + indicatorTiles;
+        neighborFullTiles += fullTiles;
+
+        if (!v.valid) {
+            String<64> str;
+            str << "      "
+                << Hex(nb.neighborAt(TOP), 2) << "\n   "
+                << Hex(nb.neighborAt(LEFT), 2) << "    "
+                << Hex(nb.neighborAt(RIGHT), 2) << "\n      "
+                << Hex(nb.neighborAt(BOTTOM), 2) << "\n   "
+                << count << "\n\n";
+            draw.text(vec(1,6), str);
+
+            for (int s = 0; s < NUM_SIDES; ++s) {
+                v.id[s] = nb.neighborAt(Side(s));
+                if (indicators)
+                    drawSideIndicator(draw, nb, Side(s));
+            }
+            v.add = c.neighborAdd;
+            v.remove = c.neighborRemove;
+            v.valid = true;
+            neighborTiles += fullTiles;
+            return;
+        }
+
+        for (int s = 0; s < NUM_SIDES; ++s) {
+            uint8_t id = nb.neighborAt(Side(s));
+            if (id == v.id[s])
+                continue;
+            v.id[s] = id;
+
+            String<4> hex;
+            hex << Hex(id, 2);
+            draw.text(neighborIDPos[s], hex);
+            neighborTiles += 2;
+            if (indicators) {
+                drawSideIndicator(draw, nb, Side(s));
+                neighborTiles += indicatorSize[s].x * indicatorSize[s].y;
+            }
+        }
 
-        drawSideIndicator(draw, nb, vec( 1,  0), vec(14,  1), TOP);
-        drawSideIndicator(draw, nb, vec( 0,  1), vec( 1, 14), LEFT);
-        drawSideIndicator(draw, nb, vec( 1, 15), vec(14,  1), BOTTOM);
-        drawSideIndicator(draw, nb, vec(15,  1), vec( 1, 14), RIGHT);
+        if (c.neighborAdd != v.add || c.neighborRemove != v.remove) {
+            draw.text(vec(4,9), count);
+            v.add = c.neighborAdd;
+            v.remove = c.neighborRemove;
+            neighborTiles += count.size();
+        }
     }
 
-    static void drawSideIndicator(BG0ROMDrawable &draw, Neighborhood &nb,
-        Int2 topLeft, Int2 size, Side s)
+    static void drawSideIndicator(BG0ROMDrawable &draw, Neighborhood &nb, Side s)
     {
         unsigned nbColor = draw.ORANGE;
-        draw.fill(topLeft, size,
+        draw.fill(indicatorPos[s], indicatorSize[s],
             nbColor | (nb.hasNeighborAt(s) ? draw.SOLID_FG : draw.SOLID_BG));
     }
 	
-	void onAccelChange(unsigned id)
+public:
+    /*
+     * Once per frame, from the main loop: bring each cube that had
+     * accelerometer events up to date once, however many there were.
+     */
+    void processAccel()
+    {
+        unsigned dirty = dirtyAccel;
+        dirtyAccel = 0;
+
+        for (unsigned id = 0; id < numCubes; ++id) {
+            if (dirty & (1 << id)) {
+                accelProcessed++;
+                updateAccel(id);
+            }
+        }
+    }
+
+private:
+    unsigned dirtyAccel;        // Bit N: cube N had events this frame
+
+    /*
+     * Event storms from shaky hands or many cubes would otherwise compete
+     * with the transmit path, so an event only does what can't wait: the
+     * stats count and the report's aggregation window see every one.
+     * Everything else is coalesced into processAccel().
+     */
+    void onAccelChange(unsigned id)
+    {
+        stats.onSensorEvent(id);
+        aggregator.onAccel(id, CubeID(id).accel());
+        accelEvents++;
+        dirtyAccel |= 1 << id;
+    }
+
+	void updateAccel(unsigned id)
 	{
         CubeID cube(id);
+
+        // The recognizer runs every frame the cube moved, even while nothing is drawn
+        unsigned changeFlags = motion[id].update();
+        if (changeFlags)
+            MCC_LOG(LOG_CAT_SENSORS, LOG_LEVEL_DEBUG, "Tilt/shake changed, flags=%08x\n", changeFlags);
+
+        if (dashboard.isActive() || !drawsStatus(id) || !power.allowSensorText(id))
+            return;
+
         auto accel = cube.accel();
 
         String<64> str;
@@ -174,12 +338,8 @@ private:
             << Fixed(accel.y, 3)
             << Fixed(accel.z, 3) << "\n";
 
-        unsigned changeFlags = motion[id].update();
         if (changeFlags) {
             // Tilt/shake changed
-
-            LOG("Tilt/shake changed, flags=%08x\n", changeFlags);
-
             auto tilt = motion[id].tilt;
             str << "tilt:"
                 << Fixed(tilt.x, 3)
@@ -194,6 +354,115 @@ private:
 	}
 };
 
+const Int2 SensorListener::neighborIDPos[NUM_SIDES] = {
+    vec( 7,  6), vec( 4,  7), vec( 7,  8), vec(10,  7)
+};
+const Int2 SensorListener::indicatorPos[NUM_SIDES] = {
+    vec( 1,  0), vec( 0,  1), vec( 1, 15), vec(15,  1)
+};
+const Int2 SensorListener::indicatorSize[NUM_SIDES] = {
+    vec(14,  1), vec( 1, 14), vec(14,  1), vec( 1, 14)
+};
+
+static SensorListener sensors;
+
+// A feedback effect ended; the dashboard doesn't use the border, the normal screen does
+static void restoreAfterFeedback(unsigned id)
+{
+    if (dashboard.isActive())
+        dashboard.draw(stats.last());
+    else
+        sensors.redrawNeighbors(id);
+}
+
+// The host gave a cube's screen back
+static void restoreAfterTiles(unsigned id)
+{
+    if (dashboard.isActive()) {
+        dashboard.draw(stats.last());
+        return;
+    }
+    sensors.redraw(id);
+    if (id == 0) {
+        drawConnectionState();
+        updatePacketCounts(0, 0);
+    }
+}
+
+/*
+ * Background tasks for the main loop, one per frame at most. The link
+ * monitor and the displays work from the latest capture, so they follow
+ * it a frame or two later in the same second.
+ */
+
+static void captureStats()
+{
+    // Also captures btCounters, for the log below
+    stats.capture();
+}
+
+static void updateLinkMonitor()
+{
+    linkMonitor.update(stats.last());
+}
+
+static void refreshDisplay()
+{
+    dashboard.draw(stats.last());
+    advertiser.update(stats.last());
+}
+
+static void flushCalibration()
+{
+    calibration.flush();
+}
+
+// For debugging, periodically log the counters
+static void logCounters()
+{
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "BT-Counters: rxPackets=%d txPackets=%d rxBytes=%d txBytes=%d rxUserDropped=%d\n",
+        btCounters.receivedPackets(), btCounters.sentPackets(),
+        btCounters.receivedBytes(), btCounters.sentBytes(),
+        btCounters.userPacketsDropped());
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Power: textSkipped=%d labelsSkipped=%d samplesSkipped=%d reassignments=%d\n",
+        power.stats().textSkipped, power.stats().labelsSkipped,
+        power.stats().samplesSkipped, power.stats().reassignments);
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Aggregator: events=%d emptyWindows=%d\n",
+        aggregator.events(), aggregator.emptyWindows());
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Calibration: restRuns=%d ignoredRuns=%d captures=%d loads=%d saves=%d\n",
+        calibration.stats().restRuns, calibration.stats().ignoredRuns, calibration.stats().captures,
+        calibration.stats().loads, calibration.stats().saves);
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Sensors: accelEvents=%d accelProcessed=%d neighborTiles=%d (full redraws %d)\n",
+        sensors.accelEvents, sensors.accelProcessed,
+        sensors.neighborTiles, sensors.neighborFullTiles);
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "HostLink: messages=%d echoed=%d overwritten=%d unknown=%d rejected=%d\n",
+        hostLink.messages(), hostLink.echoed(),
+        hostLink.overwritten(), hostLink.unknown(), hostLink.rejected());
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Macros: started=%d ticks=%d\n",
+        macros.stats().started, macros.stats().ticks);
+    const HostTiles::Counters &ht = hostTiles.stats();
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Tiles: messages=%d tiles=%d rejected=%d claims=%d releases=%d\n",
+        ht.messages, ht.tiles, ht.rejected, ht.claims, ht.releases);
+    const Feedback::Counters &fb = feedback.stats();
+    MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Feedback: messages=%d entries=%d rejected=%d overwritten=%d painted=%d latencyAvgUS=%d latencyMaxUS=%d\n",
+        fb.messages, fb.entries, fb.rejected, fb.overwritten, fb.painted,
+        fb.painted ? fb.latencySumUS / fb.painted : 0, fb.latencyMaxUS);
+
+    for (unsigned i = 0; i < scheduler.numTasks(); ++i) {
+        const Scheduler::TaskStats &t = scheduler.stats(i);
+        MCC_LOG(LOG_CAT_STATS, LOG_LEVEL_INFO, "Task %s: runs=%d overruns=%d deferred=%d skipped=%d worstUS=%d\n",
+            scheduler.task(i).name, t.runs, t.overruns, t.deferred, t.skipped, t.worstUS);
+    }
+}
+
+// Name, function, period (ms), budget (us)
+static const Scheduler::Task backgroundTasks[] = {
+    { "stats",       captureStats,      1000, 500 },
+    { "link",        updateLinkMonitor, 1000, 200 },
+    { "display",     refreshDisplay,    1000, 4000 },
+    { "calibration", flushCalibration,  1000, 20000 },     // A save writes flash
+    { "log",         logCounters,       1000, 2000 },
+};
 /**
 * above added for neighbor 
 */
@@ -203,11 +472,14 @@ void main()
      * Display text in BG0_ROM mode on Cube 0
      */
 
-    for (CubeID cube : allCubes) {
+    for (unsigned cube = 0; cube < numDisplays; ++cube) {
         vid[cube].initMode(BG0_ROM);
         vid[cube].attach(cube);
+    }
 
-    }	
+    MCC_LOG(LOG_CAT_UI, LOG_LEVEL_INFO, "RAM: %d cubes, %d with display: video=%d (%d each) motion=%d aggregator=%d calibration=%d highres=%d power=%d stats=%d\n",
+        numCubes, numDisplays, sizeof vid, sizeof vid[0], sizeof motion,
+        sizeof aggregator, sizeof calibration, sizeof highRes, sizeof power, sizeof stats);
     /*
      * If Bluetooth isn't supported, don't go on.
      */
@@ -222,6 +494,19 @@ void main()
 
     // Zero out our counters
     btCounters.reset();
+    trace.init();
+    stats.init();
+    power.init();
+    linkMonitor.init();
+    session.init();
+    hostLink.init();
+    mouse.init();
+    highRes.init();
+    aggregator.init();
+    calibration.init();
+    macros.init();
+    feedback.init(restoreAfterFeedback);
+    hostTiles.init(restoreAfterTiles);
 
     /*
      * Advertise some "game state" to the peer. Mobile apps can read this
@@ -230,14 +515,12 @@ void main()
      * tells a mobile app whether or not we're in a game state where Bluetooth
      * interaction makes sense.
      *
-     * In this demo, we'll report the number of times the cube has been touched,
-     * and its current touch state. Advertisement data is totally optional, and
-     * if your game doesn't have a use for this feature it's fine not to use it.
+     * We report a compact snapshot of the controller (connected cubes,
+     * battery levels, link rates; see advertise.h). It is refreshed from the
+     * main loop at the same low rate as our statistics.
      */
-/** delete for bt test 20181102
-    Events::cubeTouch.set(onCubeTouch);
-    onCubeTouch(0, cube);
-*/
+    advertiser.update(stats.last());
+
     /*
      * Handle sending and receiving Bluetooth data entirely with Events.
      * Our BluetoothPipe is a buffer that holds packets that have been
@@ -268,7 +551,7 @@ void main()
      */
 
 	btPipe.attach();
-//    Events::bluetoothReadAvailable.set(onReadAvailable);
+    Events::bluetoothReadAvailable.set(onReadAvailable);
 	
     updatePacketCounts(0, 0);
 
@@ -288,106 +571,104 @@ void main()
 /**
 * below added for neighbor 
 */	
-    static SensorListener sensors;
     sensors.install();
 /**
 * above added for neighbor 
 */	
 	
     /*
-     * Everything else happens in event handlers, nothing to do in our main loop.
+     * Input is all event handlers; the main loop paints, polls the pipe, and
+     * spreads the background work across frames (see scheduler.h).
      */
 
+    scheduler.init(backgroundTasks, arraysize(backgroundTasks), SystemTime::now());
+
     while (1) {
+        stats.sampleQueue(btPipe.sendQueue.readAvailable(), 1);
+        sensors.processAccel();
+        macros.tick(SystemTime::now());
+        feedback.apply(SystemTime::now());
+        System::paint();
+        feedback.afterPaint();
 
-        for (unsigned n = 0; n < 60; n++) {
-            System::paint();
-        }
         /*
-         * For debugging, periodically log the Bluetooth packet counters.
+         * A throttled link leaves the queue empty without another
+         * bluetoothWriteAvailable event coming, so poll once a frame.
          */
+        if (Bluetooth::isConnected())
+            onWriteAvailable();
+        else
+            session.prebuild();
 
-        btCounters.capture();
-        LOG("BT-Counters: rxPackets=%d txPackets=%d rxBytes=%d txBytes=%d rxUserDropped=%d\n",
-            btCounters.receivedPackets(), btCounters.sentPackets(),
-            btCounters.receivedBytes(), btCounters.sentBytes(),
-            btCounters.userPacketsDropped());
+        scheduler.runFrame(SystemTime::now());
     }
 }
 
-void onCubeTouch(void *context, unsigned id)
+void drawConnectionState()
 {
-    /*
-     * Keep track of how many times this cube has been touched
-     */
+    if (dashboard.isActive() || !drawsStatus(0))
+        return;
 
-    CubeID cube = id;
-    bool isTouching = cube.isTouching();
-    static uint32_t numTouches = 0;
-
-    if (isTouching) {
-        numTouches++;
+    if (!Bluetooth::isConnected()) {
+        vid[0].bg0rom.text(vec(0,2), " Waiting for a  ");
+        vid[0].bg0rom.text(vec(0,3), " connection...  ");
+        return;
     }
 
-    /*
-     * Set our current Bluetooth "advertisement" data to a blob of information about
-     * cube touches. In a real game, you'd use this to store any game state that
-     * a mobile app may passively want to know without explicitly requesting it
-     * from the running game.
-     *
-     * This packet can be up to 19 bytes long. We'll use a maximum-length packet
-     * as an example, but this packet can indeed be shorter.
-     */
-
-    struct {
-        uint8_t count;
-        uint8_t touch;
-        uint8_t placeholder[17];
-    } packet = {
-        numTouches,
-        isTouching
-    };
-
-    // Fill placeholder with some sequential bytes
-    for (unsigned i = 0; i < sizeof packet.placeholder; ++i)
-        packet.placeholder[i] = 'A' + i;
-
-    LOG("Advertising state: %d bytes, %19h\n", sizeof packet, &packet);
-    Bluetooth::advertiseState(packet);
-}
-
-void onConnect()
-{
-    LOG("onConnect() called\n");
-    ASSERT(Bluetooth::isConnected() == true);
-
     vid[0].bg0rom.text(vec(0,2), "   Connected!   ");
 //    vid[0].bg0rom.text(vec(0,3), "                ");
 //    vid[0].bg0rom.text(vec(0,8), " Last received: ");
 
-    // Start trying to write immediately
-
 	if(btPipe.writeAvailable()){
 		vid[0].bg0rom.text(vec(0,3), " writeAvailable ");
 	}
 	else{
 		vid[0].bg0rom.text(vec(0,3), "   writeNG   ");
 	}
-	
+}
+
+void onConnect()
+{
+    MCC_LOG(LOG_CAT_PIPE, LOG_LEVEL_INFO, "onConnect() called\n");
+    TRACE(TRACE_CONNECT, 0, 0);
+    ASSERT(Bluetooth::isConnected() == true);
+
+    // Start trying to write immediately, before spending time on the display
+    session.onConnect();
     Events::bluetoothWriteAvailable.set(onWriteAvailable);
 	onWriteAvailable();
+
+    drawConnectionState();
 }
 
 void onDisconnect()
 {
-    LOG("onDisconnect() called\n");
+    MCC_LOG(LOG_CAT_PIPE, LOG_LEVEL_INFO, "onDisconnect() called\n");
+    TRACE(TRACE_DISCONNECT, 0, 0);
     ASSERT(Bluetooth::isConnected() == false);
 
-    vid[0].bg0rom.text(vec(0,2), " Waiting for a  ");
-    vid[0].bg0rom.text(vec(0,3), " connection...  ");
+    drawConnectionState();
 
-    // Stop trying to write
+    // Stop trying to write, and get the first report of the next session ready
     Events::bluetoothWriteAvailable.unset();
+    session.onDisconnect();
+}
+
+void toggleDashboard()
+{
+    // The same gesture dumps the trace ring, when it's compiled in
+    trace.dump();
+
+    if (dashboard.toggle())
+        return;
+
+    // Back to the normal screens
+    for (CubeID cube : CubeSet::connected())
+        if (cube < numCubes)
+            sensors.redraw(cube);
+
+    drawConnectionState();
+    updatePacketCounts(0, 0);
 }
 
 void updatePacketCounts(int tx, int rx)
@@ -400,6 +681,9 @@ void updatePacketCounts(int tx, int rx)
     txCount += tx;
     rxCount += rx;
 
+    if (dashboard.isActive() || !drawsStatus(0))
+        return;
+
     String<17> str;
 /**    
 	str << "RX: " << rxCount;
@@ -426,7 +710,8 @@ void packetHexDumpLine(const BluetoothPacket &packet, String<17> &str, unsigned
 
 void onReadAvailable()
 {
-    LOG("onReadAvailable() called\n");
+    MCC_LOG(LOG_CAT_PIPE, LOG_LEVEL_VERBOSE, "onReadAvailable() called\n");
+    TRACE(TRACE_READ_CALLED, 0, 0);
 
     /*
      * This is one way to read packets from the BluetoothPipe; using read(),
@@ -434,15 +719,26 @@ void onReadAvailable()
      * method would use peek() to access the next packet, and pop() to remove it.
      */
     BluetoothPacket packet;
-    while (btPipe.read(packet) && btPipe.readAvailable()) {		
-//    while (btPipe.read(packet)) {	
+    SystemTime now = SystemTime::now();
+
+    while (btPipe.read(packet)) {
+        // Update our counters
+        updatePacketCounts(0, 1);
+        TRACE(TRACE_RECEIVED, packet.type(), packet.size() | (packet.bytes()[0] << 8));
+
+        // Host messages are handled quietly; they arrive several times a second
+        if (hostLink.onMessage(packet, now))
+            continue;
+
         /*
-         * We received a packet over the Bluetooth link!
+         * We received some other packet over the Bluetooth link!
          * Dump out its contents in hexadecimal, to the log and the display.
          */
 
-        LOG("Received: %d bytes, type=%02x, data=%19h\n",
+        MCC_LOG(LOG_CAT_PIPE, LOG_LEVEL_VERBOSE, "Received: %d bytes, type=%02x, data=%19h\n",
             packet.size(), packet.type(), packet.bytes());
+        if (!drawsStatus(0))
+            continue;
 
         String<17> str;
 
@@ -457,9 +753,6 @@ void onReadAvailable()
 
         packetHexDumpLine(packet, str, 16);
         vid[0].bg0rom.text(vec(0,14), str);
-
-        // Update our counters
-        updatePacketCounts(0, 1);
     }
 }
 
@@ -468,9 +761,96 @@ void onReadAvailable()
 *	You can modify the map accourding to your games' request. Here we use Tai as example.
 *
 */
+void buildReport(uint8_t *bytes, bool drawLabels)
+{
+    for (unsigned i = 0; i < reportSize; ++i) {
+		bytes[i] = 0;			
+    }
+	
+    /** 
+     * Get the accelerometer data from Cube0 Cube1 Cube2...
+	 * We have totally 20 bytes for HID transmit, first byte for padding ( system internal use )
+	 * Second  bytes[0] byte for Joystick's axis.X
+	 * Third   bytes[1] byte for Joystick's axis.Y
+	 * Fourth  bytes[2] byte for Joystick's axis.Z
+	 * Fifth   bytes[3] byte for Joystick's axis.Rx
+	 * Then 15 bits for buttons
+	 * Others  bits for reserved
+	 * The host tools decode this layout from report.h; keep the two in step.
+     */	
+	 
+	/**
+	 * Cube0/1/2 below are the cubes holding the stick/left/right roles.
+	 * Normally that's cubes 0, 1 and 2, but Power moves the stick off a cube
+	 * whose battery is critical, and samples low cubes less often.
+	 *
+	 * A sample is a summary of every accelerometer event since the cube's
+	 * previous one (aggregate.h); mapping.lua picks which statistic.
+	 */
+	CubeID cube0 = power.cubeFor(Power::ROLE_STICK);
+	CubeID cube1 = power.cubeFor(Power::ROLE_LEFT);
+	CubeID cube2 = power.cubeFor(Power::ROLE_RIGHT);
+	const unsigned roleCubes[3] = { cube0, cube1, cube2 };
+	for (unsigned r = 0; r < 3; ++r)
+		if (power.sampleDue(roleCubes[r]))
+			aggregator.close(roleCubes[r], CubeID(roleCubes[r]).accel());
+	TaiAccel accel_Cube0 = aggregator.summary(cube0).select(mappingSampling);
+	TaiAccel accel_Cube1 = aggregator.summary(cube1).select(mappingSampling);
+	TaiAccel accel_Cube2 = aggregator.summary(cube2).select(mappingSampling);
+	bool isTouching_Cube0 = cube0.isTouching();		
+	bool isTouching_Cube1 = cube1.isTouching();
+	bool isTouching_Cube2 = cube2.isTouching();
+	bool drawLabels_Cube1 = drawLabels && drawsStatus(cube1) && power.labelsEnabled(cube1);
+	bool drawLabels_Cube2 = drawLabels && drawsStatus(cube2) && power.labelsEnabled(cube2);
+
+	TaiSample sample;
+	sample.cube[0] = accel_Cube0;
+	sample.cube[1] = accel_Cube1;
+	sample.cube[2] = accel_Cube2;
+	sample.touching[0] = isTouching_Cube0;
+	sample.touching[1] = isTouching_Cube1;
+	sample.touching[2] = isTouching_Cube2;
+	sample.neighboring = neighboring;
+
+	// The mapping itself is data: mapping.lua, compiled into mapping.gen.h.
+	// The host picks joystick or mouse; both come from the same sample.
+	unsigned mode = session.mode();
+	if (mode == REPORT_MODE_MOUSE) {
+		mouse.build(sample, bytes);
+	} else {
+		mapReport(sample, bytes);
+		macros.apply(bytes);
+		highRes.build(roleCubes, sample, bytes);
+	}
+	setReportMode(bytes, mode);
+
+	// Light up the tilt button labels on cube1 & cube2 while they trigger
+	if (drawLabels_Cube1) {
+		vid[cube1].bg0rom.text(vec(7,14), "A");				//A	Down	(7,14)
+		if (accel_Cube1.y > mappingTrigger)
+			vid[cube1].bg0rom.text(vec(7,14), "A", vid[cube1].bg0rom.WHITE_ON_TEAL);
+		vid[cube1].bg0rom.text(vec(14,7), "B");				//B	Right	(14,7)
+		if (accel_Cube1.x > mappingTrigger)
+			vid[cube1].bg0rom.text(vec(14,7), "B", vid[cube1].bg0rom.WHITE_ON_TEAL);
+	}
+	if (drawLabels_Cube2) {
+		vid[cube2].bg0rom.text(vec(7,14), "X");				//X	Down	(7,14)
+		if (accel_Cube2.y > mappingTrigger)
+			vid[cube2].bg0rom.text(vec(7,14), "X", vid[cube2].bg0rom.WHITE_ON_TEAL);
+		vid[cube2].bg0rom.text(vec(14,7), "Y");				//Y	Right	(14,7)
+		if (accel_Cube2.x > mappingTrigger)
+			vid[cube2].bg0rom.text(vec(14,7), "Y", vid[cube2].bg0rom.WHITE_ON_TEAL);
+	}
+}
+
 void onWriteAvailable()
 {
-    LOG("onWriteAvailable() called\n");
+    MCC_LOG(LOG_CAT_PIPE, LOG_LEVEL_VERBOSE, "onWriteAvailable() called\n");
+    TRACE(TRACE_WRITE_CALLED, btPipe.sendQueue.writeAvailable(), 0);
+
+    // The button labels share the screen with the dashboard
+    bool drawLabels = !dashboard.isActive();
+    SystemTime now = SystemTime::now();
 
     /*
      * This is one way to write packets to the BluetoothPipe; using reserve()
@@ -478,7 +858,8 @@ void onWriteAvailable()
      * BluetoothPipe, you can use write().
      */
 
-    while (Bluetooth::isConnected() && btPipe.writeAvailable()) {
+    while (Bluetooth::isConnected() && btPipe.writeAvailable()
+        && (hostLink.echoPending() || linkMonitor.readyToSend(now))) {
         /*
          * Access some buffer space for writing the next packet. This
          * is the zero-copy API for writing packets. Both reading and writing
@@ -487,205 +868,60 @@ void onWriteAvailable()
 
         BluetoothPacket &packet = btPipe.sendQueue.reserve();
 
-        /*
-         * Fill most of the packet with dummy data
-         */
-
         // 7-bit type code, for our own application's use
 		// Do not change setType(0x00), internal use !!!
         packet.setType(0x00);		
         packet.resize(packet.capacity());
+        ASSERT(packet.capacity() == reportSize);
 
-        for (unsigned i = 0; i < packet.capacity(); ++i) {
-			packet.bytes()[i] = 0;			
-        }
-		
-        /** 
-         * Get the accelerometer data from Cube0 Cube1 Cube2...
-		 * We have totally 20 bytes for HID transmit, first byte for padding ( system internal use )
-		 * Second  packet.bytes()[0] byte for Joystick's axis.X
-		 * Third   packet.bytes()[1] byte for Joystick's axis.Y
-		 * Fourth  packet.bytes()[2] byte for Joystick's axis.Z
-		 * Fifth   packet.bytes()[3] byte for Joystick's axis.Rx
-		 * Then 15 bits for buttons
-		 * Others  bits for reserved
-         */	
-		 
-		Byte3 accel_Cube0 = vid[0].physicalAccel();
-		Byte3 accel_Cube1 = vid[1].physicalAccel();
-		Byte3 accel_Cube2 = vid[2].physicalAccel();
-		CubeID cube0 = 0;		
-		CubeID cube1 = 1; 
-		CubeID cube2 = 2;
-		bool isTouching_Cube0 = cube0.isTouching();		
-		bool isTouching_Cube1 = cube1.isTouching();
-		bool isTouching_Cube2 = cube2.isTouching();
-
-		/**
-		 * Prepare the package, cube0 for the axis.X & axis.Y axis.Z
-		 * cube1 for the axis.Rx
-		 * 20 or 40 is used to gain the axis.X & axis.Y between 0 to 107		 
-		 * 107 and 20 need to be changed together due to our range for axis is 0~127
-		 */	
-		 
-		// accel_Cube0.x => X	packet.bytes()[0]
-		if (accel_Cube0.x < 87 && accel_Cube0.x > 0) {
-			packet.bytes()[0] = accel_Cube0.x + 40;
-		}
-		else if (accel_Cube0.x > -87 && accel_Cube0.x < 0) {
-			packet.bytes()[0] = accel_Cube0.x - 40;		
-		}
-		else {
-			packet.bytes()[0] = accel_Cube0.x;			
-		}
-		
-		// accel_Cube0.y => Y	packet.bytes()[1]		
-		if (accel_Cube0.y < 107 && accel_Cube0.y > 0) {
-			packet.bytes()[1] = accel_Cube0.y + 20;
-		}
-		else if (accel_Cube0.y > -107 && accel_Cube0.y < 0) {
-			packet.bytes()[1] = accel_Cube0.y - 20;		
-		}
-		else {
-			packet.bytes()[1] = accel_Cube0.y;			
-		}
-		
-		// accel_Cube0.z => Z	packet.bytes()[2]		
-		if (accel_Cube0.z < 107 && accel_Cube0.z > 0) {
-			packet.bytes()[2] = accel_Cube0.z + 20;
-		}
-		else if (accel_Cube0.z > -107 && accel_Cube0.z < 0) {
-			packet.bytes()[2] = accel_Cube0.z - 20;		
-		}
-		else {
-			packet.bytes()[2] = accel_Cube0.z;			
-		}
-		
-		// accel_Cube1.Z => Rx	packet.bytes()[3]		
-		if (accel_Cube1.z < 107 && accel_Cube1.z > 0) {
-			packet.bytes()[3] = accel_Cube1.z + 20;
-		}
-		else if (accel_Cube1.z > -107 && accel_Cube1.z < 0) {
-			packet.bytes()[3] = accel_Cube1.z - 20;		
-		}
-		else {
-			packet.bytes()[3] = accel_Cube1.z;			
-		}
-		
-		/**
-		 * Prepare the buttons, cube1&cube2 use the 15 bits equal 15 buttons
-		 * packet.bytes()[4] buttons 1~8: 0x01:A	0x02:B  0x04:C		0x08:X		0x10:Y		0x20:Z 	0x40:L1	0x80:R1
-		 * packet.bytes()[5] buttons 1~7: 0x01:L2	0x02:R2	0x04:Start	0x08:Select	0x10:Mode	0x20:T1	0x40:T2	
-		 * we need map above 15 buttons to all motions we have: 
-		 * 
-		 */
-		 
-		/**
-		 * Area	packet.bytes()[4]
-		 * buttons 1~8
-		 *  		 
-		 */	
-		int8_t Trigger = 30;		 
-//*******************************************************//		 
-
-		// accel_Cube1.y, 		
-		vid[1].bg0rom.text(vec(7,14), "A");				//A				
-		if (accel_Cube1.y > Trigger) {						//Down	(7,14)
-			packet.bytes()[4] = packet.bytes()[4] | 0x01;	//---A---//
-			vid[1].bg0rom.text(vec(7,14), "A", vid[1].bg0rom.WHITE_ON_TEAL);	//A
-		}
-		else if (accel_Cube1.y < -Trigger) {				//Up	(7,1)
-			packet.bytes()[4] = packet.bytes()[4] | 0x04;	//---C---// 
-			
-		}
-		// accel_Cube1.x, 
-		vid[1].bg0rom.text(vec(14,7), "B");				//B	
-		if (accel_Cube1.x > Trigger) {						//Right	(14,7)
-			packet.bytes()[4] = packet.bytes()[4] | 0x02;	//---B---//
-			vid[1].bg0rom.text(vec(14,7), "B", vid[1].bg0rom.WHITE_ON_TEAL);	//B		
-		}
-		else if (accel_Cube1.x < -Trigger) {				//Left	(1,7)
-			packet.bytes()[4] = packet.bytes()[4] | 0x20;	//---Z---//
-			
-		}
-		
-//*******************************************************//
-
-		//accel_Cube2.y, 
-		vid[2].bg0rom.text(vec(7,14), "X");				//X
-		if (accel_Cube2.y > Trigger) {						//Down	(7,14)
-			packet.bytes()[4] = packet.bytes()[4] | 0x08;	//---X---//
-			vid[2].bg0rom.text(vec(7,14), "X", vid[2].bg0rom.WHITE_ON_TEAL);	//X	
-		}
-		else if (accel_Cube2.y < -Trigger) {				//Up	(7,1)
-//			packet.bytes()[4] = packet.bytes()[4] | 0x10;	//---Y---// 
-			
-		}
-		
-		//accel_Cube2.x, 		
-		vid[2].bg0rom.text(vec(14,7), "Y");				//Y	
-		if (accel_Cube2.x > Trigger) {						//Right	(14,7)
-			packet.bytes()[4] = packet.bytes()[4] | 0x10;	//---Y---//
-			vid[2].bg0rom.text(vec(14,7), "Y", vid[2].bg0rom.WHITE_ON_TEAL);	//Y			
-		}			
-		else if (accel_Cube2.x < -Trigger) {				//Left	(1,7)
-//			packet.bytes()[4] = packet.bytes()[4] | 0x80;	//---R1---//
-			
-		}		
-//*******************************************************//
-		
-		//neighboring_Cube_all 		
-		if (neighboring) {
-			packet.bytes()[4] = packet.bytes()[4] | 0x02;	//---B---//
-			
-		}
-//*******************************************************//	
-	
-		//isTouching_Cube0&1&2, trigger 
-		if (isTouching_Cube0) {
-			packet.bytes()[4] = packet.bytes()[4] | 0x01;	//---A---//
-			
-		}
-		if (isTouching_Cube1) {
-			packet.bytes()[4] = packet.bytes()[4] | 0x40;	//---L1---//
-			
-		}
-		if (isTouching_Cube2) {
-			packet.bytes()[4] = packet.bytes()[4] | 0x80;	//---R1---//
-			
-		}
-
-		/**
-		 * Area	packet.bytes()[5]
-		 * buttons 1~7
-		 *  		 
-		 */	
-/*		
-			packet.bytes()[5] | = 0x01;	//L2
-		
-			packet.bytes()[5] | = 0x02;	//R2
+        /*
+         * Right after a reconnect, the session has a report ready that was
+         * built while we were waiting; send that instead of building cold.
+         */
 
-			packet.bytes()[5] | = 0x04;	//Start
+        bool first = session.takePrebuilt(packet.bytes());
+        if (!first) {
+            buildReport(packet.bytes(), drawLabels);
+            session.onBuilt(now);
+        }
 
-			packet.bytes()[5] | = 0x08;	//Select
+        /*
+         * Apply the link monitor's degradation policy. A redundant packet
+         * is left uncommitted; the main loop will poll us again next frame.
+         * Echoes are never held back, or the host's clock sync would see
+         * our rate limiting as round-trip time. Mouse motion is relative,
+         * so coarsening it would just lose travel, and a repeat of the last
+         * report is only a repeat if it moves nothing.
+         */
 
-			packet.bytes()[5] | = 0x10;	//Mode
+        bool mouse = session.mode() == REPORT_MODE_MOUSE;
+        if (!mouse)
+            linkMonitor.quantizeAxes(packet.bytes());
+        if (!first && !hostLink.echoPending() && (!mouse || Mouse::still(packet.bytes()))
+            && linkMonitor.isRedundant(packet.bytes(), now)) {
+            TRACE(TRACE_REDUNDANT, 0, 0);
+            break;
+        }
+        linkMonitor.onSent(packet.bytes(), now);
 
-			packet.bytes()[5] | = 0x20;	//T1
+        // Only committed reports consume a sequence number
+        stampReport(packet.bytes(), session.nextSequence(), now.uptimeUS());
+        hostLink.stamp(packet.bytes(), now);
+        session.onSent(packet.bytes());
 
-			packet.bytes()[5] | = 0x40;	//T2
-*/		
-		
         /*
          * Log the packet for debugging, and commit it to the FIFO.
-         * The system will asynchronously send it to our peer.
+         * The system will asynchronously send it to our peer. Only the
+         * trace is cheap enough to leave on for every packet.
          */
 
-        LOG("Sending: %d bytes, type=%02x, data=%19h\n",
+        MCC_LOG(LOG_CAT_PIPE, LOG_LEVEL_VERBOSE, "Sending: %d bytes, type=%02x, data=%19h\n",
             packet.size(), packet.type(), packet.bytes());
+        TRACE(TRACE_SENT, packet.bytes()[REPORT_SEQUENCE],
+            packet.bytes()[REPORT_BUTTONS_LO] | (packet.bytes()[REPORT_BUTTONS_HI] << 8));
 
+        stats.onPacketSent();
         btPipe.sendQueue.commit();
         updatePacketCounts(1, 0);
     }
 }
-
@@ -0,0 +1,467 @@
+-- mapgen.lua: compile a controller mapping (mapping.lua) into mapping.gen.h.
+--
+--   lua mapgen.lua mapping.lua mapping.gen.h
+--
+-- Runs the mapping file in a small sandbox that provides the DSL (axis,
+-- boost, tilt, ...), checks it, evaluates every curve over all 256 inputs
+-- and writes the tables mapping.h expects. When the mapping fits the
+-- packed kernel's shape (boost curves only, at most four tilted axes with
+-- one rule each way) it also writes the kernel's lane constants. Works
+-- with Lua 5.1 through 5.4.
+
+local input, output = arg[1], arg[2]
+if not input or not output then
+    io.stderr:write("usage: lua mapgen.lua mapping.lua mapping.gen.h\n")
+    os.exit(2)
+end
+
+local function fail(msg)
+    io.stderr:write(input .. ": " .. msg .. "\n")
+    os.exit(1)
+end
+
+-- Report layout, in step with report.h and the role order in power.h
+local AXES = { "X", "Y", "Z", "Rx" }
+local ROLES = { STICK = 0, LEFT = 1, RIGHT = 2 }
+local ACCEL = { x = 0, y = 1, z = 2 }
+local BUTTONS = { "A", "B", "C", "X", "Y", "Z", "L1", "R1",
+                  "L2", "R2", "Start", "Select", "Mode", "T1", "T2" }
+local BUTTON_BIT = {}
+for i, name in ipairs(BUTTONS) do BUTTON_BIT[name] = i - 1 end
+
+local function round(v)
+    return v >= 0 and math.floor(v + 0.5) or -math.floor(-v + 0.5)
+end
+
+local function clamp8(v)
+    return math.max(-128, math.min(127, round(v)))
+end
+
+local function checkCube(c, what)
+    for _, n in pairs(ROLES) do
+        if c == n then return c end
+    end
+    fail(what .. ": cube must be STICK, LEFT or RIGHT")
+end
+
+local function checkAccel(a, what)
+    if ACCEL[a] == nil then fail(what .. ": axis must be \"x\", \"y\" or \"z\"") end
+    return ACCEL[a]
+end
+
+-- The DSL. Curves are functions from a raw int8 to an output int8.
+local dsl = {}
+for name, n in pairs(ROLES) do dsl[name] = n end
+
+-- Parameters of boost curves, which the packed kernel can run directly
+local boosts = {}
+
+function dsl.boost(t)
+    local offset, limit = t.offset or 0, t.limit or 127
+    if offset < 0 or limit < 1 or limit > 128 then fail("boost: need offset >= 0 and limit 1..128") end
+    if limit + offset > 128 then fail("boost: offset + limit must stay within int8") end
+    local curve = function(v)
+        if v > 0 and v < limit then return v + offset end
+        if v < 0 and v > -limit then return v - offset end
+        return v
+    end
+    boosts[curve] = { offset = offset, limit = limit }
+    return curve
+end
+
+function dsl.linear(t)
+    local gain = t.gain or 1
+    return function(v) return clamp8(v * gain) end
+end
+
+function dsl.deadzone(t)
+    local width = t.width or 0
+    if width < 0 or width >= 127 then fail("deadzone: width must be 0..126") end
+    return function(v)
+        local m = math.abs(v) - width
+        if m <= 0 then return 0 end
+        local out = m * 127 / (127 - width)
+        return clamp8(v < 0 and -out or out)
+    end
+end
+
+function dsl.expo(t)
+    local k = t.amount or 0
+    if k < 0 or k > 1 then fail("expo: amount must be 0..1") end
+    return function(v)
+        local x = v / 127
+        return clamp8(127 * ((1 - k) * x + k * x * x * x))
+    end
+end
+
+function dsl.axis(t)
+    if type(t[3]) ~= "function" then fail("axis: third entry must be a curve") end
+    return { kind = "axis", cube = checkCube(t[1], "axis"), accel = checkAccel(t[2], "axis"), curve = t[3] }
+end
+
+function dsl.tilt(t)
+    if (t.above == nil) == (t.below == nil) then fail("tilt: give exactly one of above or below") end
+    local threshold = t.above or t.below
+    if threshold < -128 or threshold > 127 then fail("tilt: threshold out of range") end
+    return { kind = "tilt", cube = checkCube(t[1], "tilt"), accel = checkAccel(t[2], "tilt"),
+             above = t.above ~= nil, threshold = threshold }
+end
+
+function dsl.touch(t)
+    return { kind = "touch", cube = checkCube(t[1], "touch") }
+end
+
+function dsl.neighbor(t)
+    return { kind = "neighbor" }
+end
+
+function dsl.mouse(t)
+    local speed, deadzone, full, k = t.speed or 600, t.deadzone or 4, t.full or 64, t.expo or 0.5
+    if speed <= 0 or speed > 20000 then fail("mouse: speed must be 1..20000 counts/s") end
+    if full < 1 or full > 128 then fail("mouse: full must be 1..128") end
+    if deadzone < 0 or deadzone >= full then fail("mouse: deadzone must be 0..full-1") end
+    if k < 0 or k > 1 then fail("mouse: expo must be 0..1") end
+    local clicks = { 0, 0, 0 }
+    for name, bit in pairs({ left = 1, right = 2, middle = 4 }) do
+        if t[name] ~= nil then
+            local c = checkCube(t[name], "mouse." .. name) + 1
+            clicks[c] = clicks[c] + bit
+        end
+    end
+    return { kind = "mouse", cube = checkCube(t[1], "mouse"), speed = speed, deadzone = deadzone,
+             full = full, expo = k, clicks = clicks }
+end
+
+function dsl.highres(t)
+    local bits, smoothing = t.bits or 12, t.smoothing or 0
+    if bits < 8 or bits > 12 then fail("highres: bits must be 8..12") end
+    if smoothing < 0 or smoothing > 3 then fail("highres: smoothing must be 0..3") end
+    return { kind = "highres", bits = bits, smoothing = smoothing }
+end
+
+-- "A B" to a BUTTON_* mask expression, "" to 0
+local function buttonList(s, what)
+    local names = {}
+    for name in string.gmatch(s, "%S+") do
+        if BUTTON_BIT[name] == nil then fail(what .. ": no button named " .. name) end
+        names[#names + 1] = "BUTTON_" .. string.upper(name)
+    end
+    return #names > 0 and table.concat(names, " | ") or "0"
+end
+
+local function checkButton(name, what)
+    if type(name) ~= "string" or BUTTON_BIT[name] == nil then fail(what .. ": first entry must be a button name") end
+    return "BUTTON_" .. string.upper(name)
+end
+
+function dsl.turbo(t)
+    local hz = t.hz or 10
+    if hz <= 0 or hz > 1000 / (2 * 16) then fail("turbo: hz must be above 0 and at most 31") end
+    local period = round(1000 / hz)
+    local on = round(period / 2)
+    local button = checkButton(t[1], "turbo")
+    return { kind = "macro", trigger = button, repeat_ = true, consume = true, label = "turbo " .. t[1] .. " at " .. hz .. " Hz",
+             steps = { { buttons = button, ms = on }, { buttons = "0", ms = period - on } } }
+end
+
+function dsl.combo(t)
+    local trigger = checkButton(t[1], "combo")
+    local steps = {}
+    for i = 2, #t do
+        local s = t[i]
+        if type(s) ~= "table" or type(s[1]) ~= "string" or type(s[2]) ~= "number" then
+            fail("combo: steps are { \"buttons\", ms }")
+        end
+        if s[2] < 16 or s[2] > 65535 then fail("combo: step times must be 16..65535 ms") end
+        steps[#steps + 1] = { buttons = buttonList(s[1], "combo"), ms = round(s[2]) }
+    end
+    if #steps == 0 then fail("combo: needs at least one step") end
+    return { kind = "macro", trigger = trigger, repeat_ = false, consume = t.consume ~= false,
+             label = "combo on " .. t[1], steps = steps }
+end
+
+function dsl.steering(t)
+    local lock, deadzone = t.lock or 180, t.deadzone or 0
+    if lock < 2 or lock > 180 then fail("steering: lock must be 2..180 degrees") end
+    if deadzone < 0 or deadzone * 2 >= lock then fail("steering: deadzone must be under half the lock") end
+    return { kind = "steering", cube = checkCube(t[1], "steering"), lock = lock, deadzone = deadzone }
+end
+
+dsl.math = math
+
+-- Run the mapping file with the DSL as its globals
+local env = setmetatable({}, { __index = dsl })
+local chunk, err
+if setfenv then
+    chunk, err = loadfile(input)
+    if chunk then setfenv(chunk, env) end
+else
+    chunk, err = loadfile(input, "t", env)
+end
+if not chunk then fail(err) end
+local ok, runErr = pcall(chunk)
+if not ok then fail(runErr) end
+
+-- Gather the tables
+local axes, curves = {}, {}
+for i, name in ipairs(AXES) do
+    local a = rawget(env, name)
+    if type(a) ~= "table" or a.kind ~= "axis" then fail(name .. " must be an axis{}") end
+    axes[i] = a
+    local lut = {}
+    for raw = 0, 255 do
+        local v = raw < 128 and raw or raw - 256
+        local out = a.curve(v)
+        if out < -128 or out > 127 then fail(name .. ": curve leaves int8 at input " .. v) end
+        lut[#lut + 1] = out
+    end
+    curves[i] = lut
+end
+
+local tilts, touch, neighbor = {}, { 0, 0, 0 }, 0
+local buttons = rawget(env, "Buttons") or {}
+for _, name in ipairs(BUTTONS) do
+    local rules = buttons[name]
+    if rules then
+        local mask = "BUTTON_" .. string.upper(name)
+        for _, r in ipairs(rules) do
+            if r.kind == "tilt" then
+                tilts[#tilts + 1] = { r = r, button = mask }
+            elseif r.kind == "touch" then
+                touch[r.cube + 1] = touch[r.cube + 1] + math.floor(2 ^ BUTTON_BIT[name])
+            elseif r.kind == "neighbor" then
+                neighbor = neighbor + math.floor(2 ^ BUTTON_BIT[name])
+            else
+                fail("Buttons." .. name .. ": rules must be tilt{}, touch{} or neighbor{}")
+            end
+        end
+    end
+end
+for name in pairs(buttons) do
+    if BUTTON_BIT[name] == nil then fail("Buttons: no button named " .. tostring(name)) end
+end
+
+local mouse = rawget(env, "Mouse")
+if mouse ~= nil and (type(mouse) ~= "table" or mouse.kind ~= "mouse") then
+    fail("Mouse must be a mouse{}")
+end
+
+local SAMPLING = { last = "SAMPLING_LAST", average = "SAMPLING_AVERAGE", peak = "SAMPLING_PEAK" }
+local sampling = rawget(env, "Sampling") or "last"
+if SAMPLING[sampling] == nil then fail("Sampling must be \"last\", \"average\" or \"peak\"") end
+
+local macros = rawget(env, "Macros") or {}
+local numSteps = 0
+for i, m in ipairs(macros) do
+    if type(m) ~= "table" or m.kind ~= "macro" then fail("Macros: entries must be turbo{} or combo{}") end
+    numSteps = numSteps + #m.steps
+end
+if #macros > 8 then fail("Macros: at most 8") end
+if numSteps > 64 then fail("Macros: at most 64 steps in all") end
+
+local highres = rawget(env, "HighRes")
+if highres ~= nil and (type(highres) ~= "table" or highres.kind ~= "highres") then
+    fail("HighRes must be a highres{}")
+end
+
+local steering = rawget(env, "Steering")
+if steering ~= nil and (type(steering) ~= "table" or steering.kind ~= "steering") then
+    fail("Steering must be a steering{}")
+end
+
+-- Lanes for the packed kernel: one per tilted axis, each with at most one
+-- rule each way. Rules that can never hold take no lane.
+local swar = true
+for _, a in ipairs(axes) do
+    if not boosts[a.curve] then swar = false end
+end
+
+local lanes = {}
+for _, t in ipairs(tilts) do
+    local r = t.r
+    local never = (r.above and r.threshold >= 127) or (not r.above and r.threshold <= -128)
+    if not never then
+        local lane
+        for _, l in ipairs(lanes) do
+            if l.cube == r.cube and l.accel == r.accel then lane = l end
+        end
+        if not lane then
+            lane = { cube = r.cube, accel = r.accel }
+            lanes[#lanes + 1] = lane
+        end
+        local dir = r.above and "above" or "below"
+        if lane[dir] then swar = false end
+        lane[dir] = { threshold = r.threshold, button = t.button }
+    end
+end
+if #lanes > 4 then swar = false end
+
+local function laneWord(f)
+    local w = 0
+    for i = 4, 1, -1 do w = w * 256 + f(i) end
+    return string.format("0x%08x", w)
+end
+
+-- Write the header
+local out = {}
+local function emit(s) out[#out + 1] = s end
+
+emit("/*")
+emit(" * Controller mapping \"" .. tostring(rawget(env, "Name") or "unnamed") .. "\".")
+emit(" *")
+emit(" * Generated by mapgen.lua from " .. input .. "; do not edit.")
+emit(" */")
+emit("")
+emit("#pragma once")
+emit("")
+emit("static constexpr int8_t mappingTrigger = " .. (rawget(env, "Trigger") or 0) .. ";")
+emit("static constexpr MappingSampling mappingSampling = " .. SAMPLING[sampling] .. ";")
+emit("")
+emit("static constexpr MappingAxis mappingAxes[REPORT_NUM_AXES] = {")
+for i, a in ipairs(axes) do
+    emit(string.format("    { %d, %d },     // %s", a.cube, a.accel, AXES[i]))
+end
+emit("};")
+emit("")
+emit("// Indexed by the raw accelerometer byte, as uint8")
+emit("static constexpr int8_t mappingCurves[REPORT_NUM_AXES][256] = {")
+for i, lut in ipairs(curves) do
+    emit("    {   // " .. AXES[i])
+    for row = 0, 15 do
+        local cells = {}
+        for col = 1, 16 do cells[col] = string.format("%4d", lut[row * 16 + col]) end
+        emit("       " .. table.concat(cells, ",") .. ",")
+    end
+    emit("    },")
+end
+emit("};")
+emit("")
+emit("static constexpr unsigned mappingNumTilts = " .. #tilts .. ";")
+emit("static constexpr MappingTilt mappingTilts[" .. math.max(#tilts, 1) .. "] = {")
+for _, t in ipairs(tilts) do
+    emit(string.format("    { %d, %d, %s, %d, %s },", t.r.cube, t.r.accel,
+        t.r.above and "true" or "false", t.r.threshold, t.button))
+end
+if #tilts == 0 then emit("    { 0, 0, false, -128, 0 },") end
+emit("};")
+emit("")
+emit(string.format("static constexpr uint16_t mappingTouch[3] = { 0x%04x, 0x%04x, 0x%04x };",
+    touch[1], touch[2], touch[3]))
+emit(string.format("static constexpr uint16_t mappingNeighbor = 0x%04x;", neighbor))
+emit("")
+
+-- Degrees to binary angle units, 65536 per turn
+local function bam(deg) return round(deg * 65536 / 360) end
+if steering then
+    emit(string.format("static constexpr SteeringConfig mappingSteering = { true, %d, %d, %d };   // %g deg lock, %g deg dead zone",
+        steering.cube, bam(steering.lock / 2), bam(steering.deadzone), steering.lock, steering.deadzone))
+else
+    emit("static constexpr SteeringConfig mappingSteering = { false, 0, 0, 0 };")
+end
+emit("")
+
+emit("static constexpr unsigned mappingNumMacros = " .. #macros .. ";")
+emit("static constexpr MacroConfig mappingMacros[" .. math.max(#macros, 1) .. "] = {")
+local first = 0
+for _, m in ipairs(macros) do
+    emit(string.format("    { %s, %s, %s, %d, %d },     // %s", m.trigger, m.repeat_ and "true" or "false",
+        m.consume and "true" or "false", first, #m.steps, m.label))
+    first = first + #m.steps
+end
+if #macros == 0 then emit("    { 0, false, false, 0, 0 },") end
+emit("};")
+emit("static constexpr MacroStep mappingMacroSteps[" .. math.max(numSteps, 1) .. "] = {")
+for _, m in ipairs(macros) do
+    for _, s in ipairs(m.steps) do
+        emit(string.format("    { %s, %d },", s.buttons, s.ms))
+    end
+end
+if numSteps == 0 then emit("    { 0, 0 },") end
+emit("};")
+emit("")
+
+if highres then
+    emit(string.format("static constexpr HiresConfig mappingHires = { true, %d, %d };   // %d bits",
+        12 - highres.bits, highres.smoothing, highres.bits))
+else
+    emit("static constexpr HiresConfig mappingHires = { false, 0, 0 };")
+end
+emit("")
+
+if mouse then
+    local names = { [0] = "0", "MOUSE_LEFT", "MOUSE_RIGHT", "MOUSE_LEFT | MOUSE_RIGHT", "MOUSE_MIDDLE",
+                    "MOUSE_LEFT | MOUSE_MIDDLE", "MOUSE_RIGHT | MOUSE_MIDDLE", "MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE" }
+    local clicks = {}
+    for i = 1, 3 do clicks[i] = names[mouse.clicks[i]] end
+    emit(string.format("// %g counts/s at |tilt| %d, dead zone %d, expo %g",
+        mouse.speed, mouse.full, mouse.deadzone, mouse.expo))
+    emit("static constexpr PointerConfig mappingPointer = {")
+    emit("    true, " .. mouse.cube .. ",")
+    emit("    { " .. table.concat(clicks, ", ") .. " },")
+    emit("    {   // 8.8 counts per ms, by |tilt|")
+    local cells = {}
+    for t = 0, 128 do
+        local n = math.max(0, math.min(1, (t - mouse.deadzone) / (mouse.full - mouse.deadzone)))
+        local f = (1 - mouse.expo) * n + mouse.expo * n * n * n
+        cells[#cells + 1] = string.format("%5d", round(mouse.speed * 256 / 1000 * f))
+        if #cells == 8 or t == 128 then
+            emit("       " .. table.concat(cells, ",") .. ",")
+            cells = {}
+        end
+    end
+    emit("    },")
+    emit("};")
+else
+    emit("static constexpr PointerConfig mappingPointer = { false, 0, {}, {} };")
+end
+emit("")
+
+if not swar then
+    emit("// Too irregular for the packed kernel; mapReport() uses the tables")
+    emit("static constexpr MappingSwar mappingSwar = { false, 0, 0, {}, 0, 0, 0, 0, {}, {} };")
+else
+    local function emitButtons(dir)
+        local masks = {}
+        for n = 0, 15 do
+            local names = {}
+            for i, l in ipairs(lanes) do
+                if l[dir] and math.floor(n / 2 ^ (i - 1)) % 2 == 1 then
+                    names[#names + 1] = l[dir].button
+                end
+            end
+            masks[#masks + 1] = #names > 0 and table.concat(names, " | ") or "0"
+        end
+        emit("    {   // " .. dir)
+        for n = 1, 16 do emit("        " .. masks[n] .. ",") end
+        emit("    },")
+    end
+
+    emit("static constexpr MappingSwar mappingSwar = {")
+    emit("    true,")
+    emit("    " .. laneWord(function(i) return boosts[axes[i].curve].offset end) .. ",     // Boost offsets")
+    emit("    " .. laneWord(function(i) return 128 - boosts[axes[i].curve].limit end) .. ",     // 0x80 - boost limits")
+    local laneAxes = {}
+    for i = 1, 4 do
+        local l = lanes[i] or { cube = 0, accel = 0 }
+        laneAxes[i] = string.format("{ %d, %d }", l.cube, l.accel)
+    end
+    emit("    { " .. table.concat(laneAxes, ", ") .. " },")
+    -- v > t is u >= (t ^ 0x80) + 1 in biased unsigned lanes; v < t is not u >= (t ^ 0x80)
+    emit("    " .. laneWord(function(i)
+        local a = lanes[i] and lanes[i].above
+        return a and a.threshold + 128 + 1 or 0
+    end) .. ",     // Above: biased threshold + 1")
+    emit("    " .. laneWord(function(i) return lanes[i] and lanes[i].above and 128 or 0 end) .. ",")
+    emit("    " .. laneWord(function(i)
+        local b = lanes[i] and lanes[i].below
+        return b and b.threshold + 128 or 0
+    end) .. ",     // Below: biased threshold")
+    emit("    " .. laneWord(function(i) return lanes[i] and lanes[i].below and 128 or 0 end) .. ",")
+    emitButtons("above")
+    emitButtons("below")
+    emit("};")
+end
+
+local f = assert(io.open(output, "w"))
+f:write(table.concat(out, "\n") .. "\n")
+f:close()
@@ -0,0 +1,190 @@
+/*
+ * Controller mapping "tai".
+ *
+ * Generated by mapgen.lua from mapping.lua; do not edit.
+ */
+
+#pragma once
+
+static constexpr int8_t mappingTrigger = 30;
+static constexpr MappingSampling mappingSampling = SAMPLING_AVERAGE;
+
+static constexpr MappingAxis mappingAxes[REPORT_NUM_AXES] = {
+    { 0, 0 },     // X
+    { 0, 1 },     // Y
+    { 0, 2 },     // Z
+    { 1, 2 },     // Rx
+};
+
+// Indexed by the raw accelerometer byte, as uint8
+static constexpr int8_t mappingCurves[REPORT_NUM_AXES][256] = {
+    {   // X
+          0,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,
+         56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+         72,  73,  74,  75,  76,  77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,
+         88,  89,  90,  91,  92,  93,  94,  95,  96,  97,  98,  99, 100, 101, 102, 103,
+        104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119,
+        120, 121, 122, 123, 124, 125, 126,  87,  88,  89,  90,  91,  92,  93,  94,  95,
+         96,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+        112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+       -128,-127,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,-116,-115,-114,-113,
+       -112,-111,-110,-109,-108,-107,-106,-105,-104,-103,-102,-101,-100, -99, -98, -97,
+        -96, -95, -94, -93, -92, -91, -90, -89, -88, -87,-126,-125,-124,-123,-122,-121,
+       -120,-119,-118,-117,-116,-115,-114,-113,-112,-111,-110,-109,-108,-107,-106,-105,
+       -104,-103,-102,-101,-100, -99, -98, -97, -96, -95, -94, -93, -92, -91, -90, -89,
+        -88, -87, -86, -85, -84, -83, -82, -81, -80, -79, -78, -77, -76, -75, -74, -73,
+        -72, -71, -70, -69, -68, -67, -66, -65, -64, -63, -62, -61, -60, -59, -58, -57,
+        -56, -55, -54, -53, -52, -51, -50, -49, -48, -47, -46, -45, -44, -43, -42, -41,
+    },
+    {   // Y
+          0,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,
+         36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,
+         52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,
+         68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,  80,  81,  82,  83,
+         84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,  96,  97,  98,  99,
+        100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115,
+        116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 107, 108, 109, 110, 111,
+        112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+       -128,-127,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,-116,-115,-114,-113,
+       -112,-111,-110,-109,-108,-107,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,
+       -116,-115,-114,-113,-112,-111,-110,-109,-108,-107,-106,-105,-104,-103,-102,-101,
+       -100, -99, -98, -97, -96, -95, -94, -93, -92, -91, -90, -89, -88, -87, -86, -85,
+        -84, -83, -82, -81, -80, -79, -78, -77, -76, -75, -74, -73, -72, -71, -70, -69,
+        -68, -67, -66, -65, -64, -63, -62, -61, -60, -59, -58, -57, -56, -55, -54, -53,
+        -52, -51, -50, -49, -48, -47, -46, -45, -44, -43, -42, -41, -40, -39, -38, -37,
+        -36, -35, -34, -33, -32, -31, -30, -29, -28, -27, -26, -25, -24, -23, -22, -21,
+    },
+    {   // Z
+          0,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,
+         36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,
+         52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,
+         68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,  80,  81,  82,  83,
+         84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,  96,  97,  98,  99,
+        100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115,
+        116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 107, 108, 109, 110, 111,
+        112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+       -128,-127,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,-116,-115,-114,-113,
+       -112,-111,-110,-109,-108,-107,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,
+       -116,-115,-114,-113,-112,-111,-110,-109,-108,-107,-106,-105,-104,-103,-102,-101,
+       -100, -99, -98, -97, -96, -95, -94, -93, -92, -91, -90, -89, -88, -87, -86, -85,
+        -84, -83, -82, -81, -80, -79, -78, -77, -76, -75, -74, -73, -72, -71, -70, -69,
+        -68, -67, -66, -65, -64, -63, -62, -61, -60, -59, -58, -57, -56, -55, -54, -53,
+        -52, -51, -50, -49, -48, -47, -46, -45, -44, -43, -42, -41, -40, -39, -38, -37,
+        -36, -35, -34, -33, -32, -31, -30, -29, -28, -27, -26, -25, -24, -23, -22, -21,
+    },
+    {   // Rx
+          0,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,
+         36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,
+         52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,
+         68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,  80,  81,  82,  83,
+         84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,  96,  97,  98,  99,
+        100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115,
+        116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 107, 108, 109, 110, 111,
+        112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+       -128,-127,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,-116,-115,-114,-113,
+       -112,-111,-110,-109,-108,-107,-126,-125,-124,-123,-122,-121,-120,-119,-118,-117,
+       -116,-115,-114,-113,-112,-111,-110,-109,-108,-107,-106,-105,-104,-103,-102,-101,
+       -100, -99, -98, -97, -96, -95, -94, -93, -92, -91, -90, -89, -88, -87, -86, -85,
+        -84, -83, -82, -81, -80, -79, -78, -77, -76, -75, -74, -73, -72, -71, -70, -69,
+        -68, -67, -66, -65, -64, -63, -62, -61, -60, -59, -58, -57, -56, -55, -54, -53,
+        -52, -51, -50, -49, -48, -47, -46, -45, -44, -43, -42, -41, -40, -39, -38, -37,
+        -36, -35, -34, -33, -32, -31, -30, -29, -28, -27, -26, -25, -24, -23, -22, -21,
+    },
+};
+
+static constexpr unsigned mappingNumTilts = 6;
+static constexpr MappingTilt mappingTilts[6] = {
+    { 1, 1, true, 30, BUTTON_A },
+    { 1, 0, true, 30, BUTTON_B },
+    { 1, 1, false, -30, BUTTON_C },
+    { 2, 1, true, 30, BUTTON_X },
+    { 2, 0, true, 30, BUTTON_Y },
+    { 1, 0, false, -30, BUTTON_Z },
+};
+
+static constexpr uint16_t mappingTouch[3] = { 0x0001, 0x0040, 0x0080 };
+static constexpr uint16_t mappingNeighbor = 0x0002;
+
+static constexpr SteeringConfig mappingSteering = { false, 0, 0, 0 };
+
+static constexpr unsigned mappingNumMacros = 0;
+static constexpr MacroConfig mappingMacros[1] = {
+    { 0, false, false, 0, 0 },
+};
+static constexpr MacroStep mappingMacroSteps[1] = {
+    { 0, 0 },
+};
+
+static constexpr HiresConfig mappingHires = { true, 0, 1 };   // 12 bits
+
+// 600 counts/s at |tilt| 64, dead zone 4, expo 0.5
+static constexpr PointerConfig mappingPointer = {
+    true, 0,
+    { MOUSE_LEFT, MOUSE_RIGHT, MOUSE_MIDDLE },
+    {   // 8.8 counts per ms, by |tilt|
+           0,    0,    0,    0,    0,    1,    3,    4,
+           5,    6,    8,    9,   10,   12,   13,   15,
+          16,   17,   19,   20,   22,   24,   25,   27,
+          28,   30,   32,   34,   36,   38,   40,   42,
+          44,   46,   48,   50,   53,   55,   57,   60,
+          63,   65,   68,   71,   74,   77,   80,   83,
+          87,   90,   93,   97,  101,  105,  108,  112,
+         117,  121,  125,  130,  134,  139,  144,  149,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,  154,  154,  154,  154,  154,  154,  154,
+         154,
+    },
+};
+
+static constexpr MappingSwar mappingSwar = {
+    true,
+    0x14141428,     // Boost offsets
+    0x15151529,     // 0x80 - boost limits
+    { { 1, 1 }, { 1, 0 }, { 2, 1 }, { 2, 0 } },
+    0x9f9f9f9f,     // Above: biased threshold + 1
+    0x80808080,
+    0x00006262,     // Below: biased threshold
+    0x00008080,
+    {   // above
+        0,
+        BUTTON_A,
+        BUTTON_B,
+        BUTTON_A | BUTTON_B,
+        BUTTON_X,
+        BUTTON_A | BUTTON_X,
+        BUTTON_B | BUTTON_X,
+        BUTTON_A | BUTTON_B | BUTTON_X,
+        BUTTON_Y,
+        BUTTON_A | BUTTON_Y,
+        BUTTON_B | BUTTON_Y,
+        BUTTON_A | BUTTON_B | BUTTON_Y,
+        BUTTON_X | BUTTON_Y,
+        BUTTON_A | BUTTON_X | BUTTON_Y,
+        BUTTON_B | BUTTON_X | BUTTON_Y,
+        BUTTON_A | BUTTON_B | BUTTON_X | BUTTON_Y,
+    },
+    {   // below
+        0,
+        BUTTON_C,
+        BUTTON_Z,
+        BUTTON_C | BUTTON_Z,
+        0,
+        BUTTON_C,
+        BUTTON_Z,
+        BUTTON_C | BUTTON_Z,
+        0,
+        BUTTON_C,
+        BUTTON_Z,
+        BUTTON_C | BUTTON_Z,
+        0,
+        BUTTON_C,
+        BUTTON_Z,
+        BUTTON_C | BUTTON_Z,
+    },
+};
@@ -0,0 +1,192 @@
+/*
+ * Table-driven controller mapping.
+ *
+ * The tables come from mapping.lua, compiled by mapgen.lua into
+ * mapping.gen.h. Every axis curve is a 256-entry lookup indexed by the raw
+ * accelerometer byte, and every button rule is one compare, so the mapping
+ * costs the same whatever curves the data file asks for. The tables are
+ * constexpr and the loops have constant trip counts, so the compiler sees
+ * through all of it.
+ *
+ * Most mappings (Tai included) only use boost curves and a few tilted
+ * axes. For those the generator also emits lane constants for a packed
+ * kernel (swar.h) that does all four axes in one word and all the tilt
+ * compares in two, with no data-dependent branches at all.
+ *
+ * The same file also configures mouse mode (pointer.h), which the cube
+ * runs instead of mapReport() when the host selects it, and the optional
+ * high-res axes (REPORT_FORMAT_HIRES) that mapReportHires() adds, and the
+ * turbo/combo macros that macro.h plays on top of the mapped buttons.
+ *
+ * Like taimap.h this has no SDK dependency and is shared with the host tools.
+ */
+
+#pragma once
+#include "report.h"
+#include "taimap.h"
+#include "swar.h"
+#include "steering.h"
+#include "pointer.h"
+
+struct MappingAxis {
+    uint8_t cube;               // Index into TaiSample::cube (role)
+    uint8_t accel;              // 0 = x, 1 = y, 2 = z
+};
+
+struct MappingTilt {
+    uint8_t cube;
+    uint8_t accel;
+    bool above;                 // Else below
+    int8_t threshold;
+    uint16_t buttons;
+};
+
+struct MappingSwar {
+    bool enabled;
+    uint32_t boostOffset;       // Per axis lane
+    uint32_t boostLimitBias;    // Per axis lane, 0x80 - limit
+    MappingAxis tiltLanes[4];
+    uint32_t above;             // Biased thresholds, see mapgen.lua
+    uint32_t aboveActive;       // High bit set in lanes with a rule
+    uint32_t below;
+    uint32_t belowActive;
+    uint16_t aboveButtons[16];  // By nibble of lanes that fired
+    uint16_t belowButtons[16];
+};
+
+// Which statistic of a report's accelerometer events the mapping reads
+enum MappingSampling {
+    SAMPLING_LAST,              // The newest reading, as sampling at build time did
+    SAMPLING_AVERAGE,
+    SAMPLING_PEAK,              // Furthest from rest, so short flicks register
+};
+
+struct HiresConfig {
+    bool enabled;
+    uint8_t dropBits;           // 12 - bits: lane bits below the precision asked for
+    uint8_t smoothing;          // IIR shift over the per-report averages, 0 = none
+};
+
+// Macros: a mapped button starts a timed sequence of button states
+static const unsigned MACRO_MAX = 8;
+static const unsigned MACRO_MAX_STEPS = 64;
+static const unsigned MACRO_MIN_STEP_MS = 16;   // About a frame; shorter steps could go unseen
+
+struct MacroStep {
+    uint16_t buttons;
+    uint16_t ms;
+};
+
+struct MacroConfig {
+    uint16_t trigger;           // The mapped button that starts it
+    bool repeat;                // Loop while the trigger holds (turbo); else once per press
+    bool consume;               // The trigger's own bit is left out of the report
+    uint8_t firstStep;          // Into mappingMacroSteps
+    uint8_t numSteps;
+};
+
+#include "mapping.gen.h"
+
+// Averaged accelerometer readings with four fractional bits (raw * 16), by role
+struct HiresSample {
+    int16_t cube[3][3];
+};
+
+inline int8_t mappingAccel(const TaiAccel &a, unsigned axis)
+{
+    return axis == 0 ? a.x : axis == 1 ? a.y : a.z;
+}
+
+inline uint32_t mappingLanes(const TaiSample &s, const MappingAxis *a)
+{
+    return swarPack(mappingAccel(s.cube[a[0].cube], a[0].accel),
+                    mappingAccel(s.cube[a[1].cube], a[1].accel),
+                    mappingAccel(s.cube[a[2].cube], a[2].accel),
+                    mappingAccel(s.cube[a[3].cube], a[3].accel));
+}
+
+inline void mapReportTables(const TaiSample &s, uint8_t *bytes)
+{
+    for (unsigned i = 0; i < REPORT_NUM_AXES; ++i) {
+        const MappingAxis &a = mappingAxes[i];
+        uint8_t raw = mappingAccel(s.cube[a.cube], a.accel);
+        bytes[REPORT_X + i] = mappingCurves[i][raw];
+    }
+
+    unsigned buttons = 0;
+    for (unsigned i = 0; i < mappingNumTilts; ++i) {
+        const MappingTilt &t = mappingTilts[i];
+        int8_t v = mappingAccel(s.cube[t.cube], t.accel);
+        if (t.above ? v > t.threshold : v < t.threshold)
+            buttons |= t.buttons;
+    }
+    for (unsigned i = 0; i < 3; ++i)
+        if (s.touching[i])
+            buttons |= mappingTouch[i];
+    if (s.neighboring)
+        buttons |= mappingNeighbor;
+
+    bytes[REPORT_BUTTONS_LO] = buttons;
+    bytes[REPORT_BUTTONS_HI] = buttons >> 8;
+}
+
+inline void mapReportSwar(const TaiSample &s, uint8_t *bytes)
+{
+    const MappingSwar &k = mappingSwar;
+
+    uint32_t axes = mappingLanes(s, mappingAxes);
+    swarStore(swarBoost(axes, k.boostOffset, k.boostLimitBias), bytes + REPORT_X);
+
+    // Bias to unsigned so one unsigned compare serves both signs
+    uint32_t tilt = mappingLanes(s, k.tiltLanes) ^ SWAR_HIGH;
+    unsigned up = swarNibble(swarGreaterEqual(tilt, k.above) & k.aboveActive);
+    unsigned down = swarNibble(~swarGreaterEqual(tilt, k.below) & k.belowActive);
+
+    unsigned buttons = k.aboveButtons[up] | k.belowButtons[down]
+        | (mappingTouch[0] & -unsigned(s.touching[0]))
+        | (mappingTouch[1] & -unsigned(s.touching[1]))
+        | (mappingTouch[2] & -unsigned(s.touching[2]))
+        | (mappingNeighbor & -unsigned(s.neighboring));
+
+    bytes[REPORT_BUTTONS_LO] = buttons;
+    bytes[REPORT_BUTTONS_HI] = buttons >> 8;
+}
+
+/*
+ * Fill the high-res lanes. The axes are linear: the boost curves are there
+ * to jump a game's dead zone at 8 bits, and leave a hole around zero that
+ * a host reading 12 bits shouldn't have to see. A steering wheel scales
+ * its own 16-bit axis down instead.
+ */
+inline void mapReportHires(const HiresSample &h, const TaiSample &s, uint8_t *bytes)
+{
+    int axes[REPORT_NUM_AXES];
+    int mask = ~((1 << mappingHires.dropBits) - 1);
+
+    for (unsigned i = 0; i < REPORT_NUM_AXES; ++i) {
+        const MappingAxis &a = mappingAxes[i];
+        axes[i] = h.cube[a.cube][a.accel] & mask;
+    }
+
+    if (mappingSteering.enabled) {
+        const TaiAccel &a = s.cube[mappingSteering.cube];
+        axes[0] = (steeringAxis(mappingSteering, a.x, a.y, a.z) >> 4) & mask;
+    }
+
+    packHires(bytes, axes);
+}
+
+// Fill report bytes [0..5]; the same contract as taiMap()
+inline void mapReport(const TaiSample &s, uint8_t *bytes)
+{
+    if (mappingSwar.enabled)
+        mapReportSwar(s, bytes);
+    else
+        mapReportTables(s, bytes);
+
+    // A steering wheel replaces X with its cube's roll
+    if (mappingSteering.enabled) {
+        const TaiAccel &a = s.cube[mappingSteering.cube];
+        bytes[REPORT_X] = steeringAxis(mappingSteering, a.x, a.y, a.z) >> 8;
+    }
+}
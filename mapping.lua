@@ -0,0 +1,75 @@
+-- Controller mapping: how cube motion becomes a joystick report.
+--
+-- mapgen.lua compiles this into mapping.gen.h as part of the build, the
+-- same way STIR turns assets.lua into assets.gen.*. A game variant is a
+-- different copy of this file; nothing in main.cpp changes.
+--
+-- Cubes are named by role (see power.h): STICK, LEFT and RIGHT.
+-- Accelerometer axes are "x", "y" and "z", in raw units (-128..127).
+
+Name = "tai"
+
+-- Tilt needed to press a button
+Trigger = 30
+
+-- What a report reads from the accelerometer events since the previous
+-- one: "last" (the newest reading), "average" (smoother, less jitter at a
+-- button's threshold) or "peak" (furthest from rest, so a quick flick
+-- between two reports still presses its button)
+Sampling = "average"
+
+-- Report axes. Each reads one accelerometer axis through a curve:
+--   boost{offset, limit}     push small tilts out by offset, up to limit
+--   linear{gain}             scale
+--   deadzone{width}          zero near the middle, rescaled to full range
+--   expo{amount}             0 = linear, 1 = cubic; finer control near zero
+X  = axis{ STICK, "x", boost{ offset = 40, limit = 87 } }
+Y  = axis{ STICK, "y", boost{ offset = 20, limit = 107 } }
+Z  = axis{ STICK, "z", boost{ offset = 20, limit = 107 } }
+Rx = axis{ LEFT,  "z", boost{ offset = 20, limit = 107 } }
+
+-- Steering wheel: replaces X with a cube's roll angle (integer atan2,
+-- see steering.h). lock is the lock-to-lock range and deadzone the dead
+-- band either side of center, both in degrees. Racing variants enable it:
+--   Steering = steering{ STICK, lock = 120, deadzone = 3 }
+
+-- High-res axes: the same four axes again at up to 12 bits, linear and
+-- without the boost, in bytes the 8-bit report leaves spare. They come from
+-- averaging every accelerometer event between two reports, which is where
+-- the extra bits come from; smoothing adds a 2^-n low-pass on top.
+HighRes = highres{ bits = 12, smoothing = 1 }
+
+-- Mouse mode, which the host can switch to at run time (HOST_MSG_PROFILE,
+-- see report.h): a cube's tilt moves the pointer and touches click.
+-- speed is in counts per second once |tilt| reaches full (64 is about a
+-- cube on its side), with deadzone and expo shaping the slow end like the
+-- axis curves. left, right and middle name the cube whose touch clicks.
+Mouse = mouse{ STICK, speed = 600, deadzone = 4, expo = 0.5,
+               left = STICK, right = LEFT, middle = RIGHT }
+
+-- Buttons, pressed while any of their rules hold:
+--   tilt{cube, axis, above = n}  or  below = n    (strictly)
+--   touch{cube}
+--   neighbor{}                   any two cubes neighbored
+Buttons = {
+    A  = { tilt{ LEFT, "y", above = Trigger }, touch{ STICK } },
+    B  = { tilt{ LEFT, "x", above = Trigger }, neighbor{} },
+    C  = { tilt{ LEFT, "y", below = -Trigger } },
+    X  = { tilt{ RIGHT, "y", above = Trigger } },
+    Y  = { tilt{ RIGHT, "x", above = Trigger } },
+    Z  = { tilt{ LEFT, "x", below = -Trigger } },
+    L1 = { touch{ LEFT } },
+    R1 = { touch{ RIGHT } },
+}
+
+-- Macros, played on top of the buttons above (at most 8, 64 steps in all):
+--   turbo{ button, hz = n }            pulse button while its rules hold
+--   combo{ button, { "A B", ms }, ... } on each press of button, hold each
+--                                       step's buttons for ms (16 or more);
+--                                       consume = false also reports button
+-- Step times are rounded to frames. Games with autofire or special moves
+-- enable them, for example:
+--   Macros = {
+--       turbo{ "X", hz = 10 },
+--       combo{ "R1", { "A", 60 }, { "", 30 }, { "A B", 120 } },
+--   }
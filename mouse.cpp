@@ -0,0 +1,30 @@
+/*
+ * Mouse mode on the cube side.
+ */
+
+#include "mouse.h"
+#include "mapping.h"
+
+Mouse mouse;
+
+void Mouse::init()
+{
+    bzero(*this);
+}
+
+bool Mouse::available() const
+{
+    return mappingPointer.enabled;
+}
+
+void Mouse::build(const TaiSample &sample, uint8_t *bytes)
+{
+    SystemTime now = SystemTime::now();
+
+    // No motion on the first step; a long pause moves by at most kMaxStepUS
+    int64_t us = lastAt.isValid() ? (now - lastAt).nanoseconds() / 1000 : 0;
+    unsigned dtUS = min(us, int64_t(PointerAccumulator::kMaxStepUS));
+    lastAt = now;
+
+    accumulator.step(mappingPointer, sample, dtUS, bytes);
+}
@@ -0,0 +1,39 @@
+/*
+ * Mouse mode on the cube side.
+ *
+ * Built from the same sample as the joystick report, in buildReport(),
+ * when the session is in REPORT_MODE_MOUSE. The kernel (pointer.h) needs
+ * the time since the previous report, which is all the state this adds.
+ *
+ * Every report built is one the motion in it is gone from, so it must be
+ * sent. The link monitor may only drop a mouse report as a repeat when
+ * still() says it carries no motion; then it is the same buttons again
+ * and there is nothing in it to lose.
+ */
+
+#pragma once
+#include "app.h"
+#include "pointer.h"
+
+class Mouse {
+public:
+    void init();
+
+    // Whether mapping.lua configured a mouse at all
+    bool available() const;
+
+    // Fill report bytes [0..5] in the REPORT_MODE_MOUSE layout
+    void build(const TaiSample &sample, uint8_t *bytes);
+
+    // No pointer travel in a built report
+    static bool still(const uint8_t *bytes)
+    {
+        return !bytes[REPORT_MOUSE_X] && !bytes[REPORT_MOUSE_Y];
+    }
+
+private:
+    PointerAccumulator accumulator;
+    SystemTime lastAt;
+};
+
+extern Mouse mouse;
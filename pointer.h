@@ -0,0 +1,69 @@
+/*
+ * Mouse mode: a cube's tilt as relative pointer motion.
+ *
+ * Tilt sets a velocity, not a position: the generated table maps |tilt|
+ * to counts per millisecond in 8.8 fixed point, with the dead zone and
+ * velocity curve already folded in. Each report moves the pointer by that
+ * velocity times the time since the previous report, and whatever is left
+ * under one count stays in the accumulator for next time, so even a slow
+ * tilt that makes a count every half second still moves steadily and the
+ * total travel doesn't depend on the report rate.
+ *
+ * Touching a cube clicks whichever buttons the mapping gives its role.
+ *
+ * Shared with the host tools; no SDK dependency.
+ */
+
+#pragma once
+#include "report.h"
+#include "taimap.h"
+
+struct PointerConfig {
+    bool enabled;
+    uint8_t cube;               // Role index, as in MappingAxis
+    uint8_t clicks[3];          // MOUSE_* by role, while touched
+    uint16_t velocity[129];     // 8.8 counts per ms, by |tilt|
+};
+
+class PointerAccumulator {
+public:
+    // Longest step; covers a pause in reports without a jump after it
+    static const unsigned kMaxStepUS = 50000;
+
+    void reset() { accX = accY = 0; }
+
+    /*
+     * Advance by dtUS at the sample's tilt and fill the report's motion
+     * and buttons. The counts written are gone from the accumulator; only
+     * the fraction is kept.
+     */
+    void step(const PointerConfig &c, const TaiSample &s, unsigned dtUS, uint8_t *bytes)
+    {
+        const TaiAccel &a = s.cube[c.cube];
+        unsigned dt = dtUS < kMaxStepUS ? dtUS : kMaxStepUS;
+
+        bytes[REPORT_MOUSE_X] = drain(accX, c, a.x, dt);
+        bytes[REPORT_MOUSE_Y] = drain(accY, c, a.y, dt);
+        bytes[REPORT_MOUSE_BUTTONS] = (c.clicks[0] & -unsigned(s.touching[0]))
+            | (c.clicks[1] & -unsigned(s.touching[1]))
+            | (c.clicks[2] & -unsigned(s.touching[2]));
+    }
+
+private:
+    static const int32_t kLimit = 127 * 256 + 255;
+
+    int32_t accX, accY;         // 8.8 counts not yet reported
+
+    static int8_t drain(int32_t &acc, const PointerConfig &c, int8_t v, unsigned dtUS)
+    {
+        // At most 20000 counts/s (5120) times kMaxStepUS; no overflow
+        int32_t move = int32_t(c.velocity[v < 0 ? -v : v] * dtUS / 1000);
+        acc += v < 0 ? -move : move;
+        acc = acc > kLimit ? kLimit : acc < -kLimit ? -kLimit : acc;
+
+        // Toward zero, so a fraction either way waits for a whole count
+        int32_t counts = acc / 256;
+        acc -= counts * 256;
+        return int8_t(counts);
+    }
+};
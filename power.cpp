@@ -0,0 +1,142 @@
+/*
+ * Battery-aware power management.
+ */
+
+#include "power.h"
+
+Power power;
+
+const PowerPolicy Power::defaultPolicy = {
+    0.30f,      // saveBelow
+    0.12f,      // criticalBelow
+    0.05f,      // hysteresis
+    500,        // saveTextMS
+    1,          // saveSampleShift: every 2nd report
+    2,          // criticalSampleShift: every 4th report
+};
+
+void Power::init()
+{
+    bzero(*this);
+    policy = defaultPolicy;
+    for (unsigned r = 0; r < NUM_ROLES; ++r)
+        roles[r] = r;
+}
+
+void Power::setPolicy(const PowerPolicy &p)
+{
+    policy = p;
+    for (unsigned i = 0; i < numCubes; ++i)
+        applyLevel(i);
+}
+
+char Power::levelCode(Level l)
+{
+    switch (l) {
+        case POWER_NORMAL:      return 'N';
+        case POWER_SAVE:        return 'S';
+        case POWER_CRITICAL:    return 'C';
+        default:                return '?';
+    }
+}
+
+Power::Level Power::levelFor(float battery, Level previous) const
+{
+    // Stepping down is immediate; stepping up needs a margin of extra charge
+    float margin = policy.hysteresis;
+
+    if (battery < policy.criticalBelow ||
+        (previous == POWER_CRITICAL && battery < policy.criticalBelow + margin))
+        return POWER_CRITICAL;
+
+    if (battery < policy.saveBelow ||
+        (previous >= POWER_SAVE && battery < policy.saveBelow + margin))
+        return POWER_SAVE;
+
+    return POWER_NORMAL;
+}
+
+void Power::onBatteryChange(unsigned id)
+{
+    if (id >= numCubes)
+        return;
+
+    Level l = levelFor(CubeID(id).batteryLevel(), levels[id]);
+    if (l == levels[id])
+        return;
+
+    MCC_LOG(LOG_CAT_POWER, LOG_LEVEL_INFO, "Power: cube %d %c -> %c\n", id, levelCode(levels[id]), levelCode(l));
+    levels[id] = l;
+    applyLevel(id);
+    reassignRoles();
+}
+
+void Power::applyLevel(unsigned id)
+{
+    switch (levels[id]) {
+        case POWER_NORMAL:      sampleMask[id] = 0; break;
+        case POWER_SAVE:        sampleMask[id] = (1 << policy.saveSampleShift) - 1; break;
+        case POWER_CRITICAL:    sampleMask[id] = (1 << policy.criticalSampleShift) - 1; break;
+    }
+}
+
+bool Power::allowSensorText(unsigned id)
+{
+    switch (levels[id]) {
+        case POWER_NORMAL:
+            return true;
+
+        case POWER_SAVE: {
+            SystemTime now = SystemTime::now();
+            if (lastText[id].isValid() &&
+                (now - lastText[id]) < TimeDelta::fromMillisec(policy.saveTextMS))
+                break;
+            lastText[id] = now;
+            return true;
+        }
+
+        default:
+            break;
+    }
+
+    counters.textSkipped++;
+    return false;
+}
+
+void Power::reassignRoles()
+{
+    /*
+     * Only the stick role matters enough to move. If its cube is critical,
+     * swap roles with the cube that has the most charge left, as long as
+     * that one is actually better off.
+     */
+
+    unsigned stick = roles[ROLE_STICK];
+    if (levels[stick] != POWER_CRITICAL)
+        return;
+
+    unsigned best = stick;
+    float bestCharge = CubeID(stick).batteryLevel();
+    for (CubeID cube : CubeSet::connected()) {
+        if (cube >= numCubes || levels[cube] == POWER_CRITICAL)
+            continue;
+        float charge = cube.batteryLevel();
+        if (charge > bestCharge) {
+            best = cube;
+            bestCharge = charge;
+        }
+    }
+    if (best == stick)
+        return;
+
+    for (unsigned r = 0; r < NUM_ROLES; ++r) {
+        if (roles[r] == best) {
+            roles[r] = stick;
+            break;
+        }
+    }
+    roles[ROLE_STICK] = best;
+    counters.reassignments++;
+
+    MCC_LOG(LOG_CAT_POWER, LOG_LEVEL_INFO, "Power: stick role moved from cube %d to cube %d\n", stick, best);
+}
@@ -0,0 +1,107 @@
+/*
+ * Battery-aware power management.
+ *
+ * Every cube gets a power level from its battery charge. Cubes running low
+ * get less display traffic (throttled sensor text, no button label redraws)
+ * and are sampled into reports less often, and the stick role, which the
+ * game can least afford to lose, is moved off a critical cube onto the
+ * healthiest one.
+ *
+ * Thresholds live in a PowerPolicy so a game variant can tune them.
+ */
+
+#pragma once
+#include "app.h"
+
+struct PowerPolicy {
+    // Battery thresholds, as a fraction of full charge
+    float saveBelow;
+    float criticalBelow;
+    float hysteresis;       // Extra charge needed before stepping back up
+
+    // Minimum interval between sensor text redraws in POWER_SAVE
+    unsigned saveTextMS;
+
+    // Sample a cube's accelerometer into every 2^N'th report
+    uint8_t saveSampleShift;
+    uint8_t criticalSampleShift;
+};
+
+class Power {
+public:
+    enum Level {
+        POWER_NORMAL,
+        POWER_SAVE,
+        POWER_CRITICAL,
+    };
+
+    /*
+     * What each cube contributes to the report. Roles are a permutation of
+     * the cubes; reassignment swaps two of them.
+     */
+    enum Role {
+        ROLE_STICK,     // X/Y/Z axes, touch = A
+        ROLE_LEFT,      // Rx axis, A/B/C/Z tilt buttons, touch = L1
+        ROLE_RIGHT,     // X/Y tilt buttons, touch = R1
+        NUM_ROLES
+    };
+
+    struct Counters {
+        unsigned textSkipped;
+        unsigned labelsSkipped;
+        unsigned samplesSkipped;
+        unsigned reassignments;
+    };
+
+    static const PowerPolicy defaultPolicy;
+
+    void init();
+    void setPolicy(const PowerPolicy &p);
+
+    void onBatteryChange(unsigned id);
+
+    Level level(unsigned id) const { return levels[id]; }
+    static char levelCode(Level l);
+
+    unsigned cubeFor(Role r) const { return roles[r]; }
+
+    bool labelsEnabled(unsigned id)
+    {
+        if (levels[id] == POWER_NORMAL)
+            return true;
+        counters.labelsSkipped++;
+        return false;
+    }
+
+    bool allowSensorText(unsigned id);
+
+    /*
+     * Whether this report takes a fresh sample of the cube, at its power
+     * level's rate. Otherwise it reuses the last one, and the cube's
+     * accelerometer events keep accumulating for the next.
+     */
+    bool sampleDue(unsigned id)
+    {
+        if ((sampleCount[id]++ & sampleMask[id]) == 0)
+            return true;
+        counters.samplesSkipped++;
+        return false;
+    }
+
+    const Counters &stats() const { return counters; }
+
+private:
+    PowerPolicy policy;
+    Level levels[numCubes];
+    uint8_t roles[NUM_ROLES];
+    uint8_t sampleMask[numCubes];
+    uint8_t sampleCount[numCubes];
+    SystemTime lastText[numCubes];
+    Counters counters;
+
+    Level levelFor(float battery, Level previous) const;
+    void applyLevel(unsigned id);
+    void reassignRoles();
+};
+
+extern Power power;
@@ -0,0 +1,365 @@
+/*
+ * MCC report wire format.
+ *
+ * Shared between the cube side (buildReport() in main.cpp) and the host
+ * tools in host/, so it must not depend on the Sifteo SDK. Host builds
+ * define MCC_HOST.
+ *
+ * A report is one 19-byte BluetoothPacket payload of type 0x00:
+ *
+ *   [0]     Axis X      signed
+ *   [1]     Axis Y      signed
+ *   [2]     Axis Z      signed
+ *   [3]     Axis Rx     signed
+ *   [4]     Buttons 1-8     A B C X Y Z L1 R1 (bit 0 first)
+ *   [5]     Buttons 9-15    L2 R2 Start Select Mode T1 T2
+ *   [6]     Format      REPORT_FORMAT_* in the low nibble; 0 is the
+ *                       original 6-byte layout with the rest zero.
+ *                       REPORT_MODE_* in the high nibble
+ *
+ * That is the joystick layout, REPORT_MODE_JOYSTICK (0, so older hosts
+ * never see anything else unless they ask for it). In REPORT_MODE_MOUSE
+ * bytes [0..5] are a relative pointer report instead:
+ *
+ *   [0]     dX          signed counts since the previous report
+ *   [1]     dY          signed counts, positive is down
+ *   [2..3]  Reserved, zero
+ *   [4]     Buttons     MOUSE_* bits
+ *   [5]     Reserved, zero
+ *
+ * From REPORT_FORMAT_SEQUENCED on:
+ *
+ *   [7]     Sequence    +1 for every report the base commits, wrapping
+ *   [8..9]  Timestamp   Base uptime in milliseconds when the report was
+ *                       committed, little-endian, wrapping
+ *
+ * From REPORT_FORMAT_ECHO on:
+ *
+ *   [10]    Fraction    Sub-millisecond part of the timestamp, 1/256 ms
+ *   [11]    Echo        Id of the last host message the base received, or
+ *                       0 if none arrived since the previous report
+ *   [12]    Hold        Time from receiving that message to committing this
+ *                       report, in 100 us units; 255 means "too long to use"
+ *
+ * From REPORT_FORMAT_HIRES on (joystick mode only):
+ *
+ *   [13..18] High-res   The four axes again as 12-bit signed lanes, packed
+ *                       little-endian: X in bits 0-11, Y 12-23, Z 24-35,
+ *                       Rx 36-47. Bytes [0..3] still carry the 8-bit axes
+ *                       for hosts that don't read these
+ *
+ * Packets from the host to the base use the same 19-byte payload. Their
+ * type is a HOST_MSG_* code and byte 0 is a host-chosen id, 1-255, that
+ * comes back in the Echo field so the host can time the round trip. Any
+ * body follows the id.
+ */
+
+#pragma once
+
+#ifdef MCC_HOST
+#include <stdint.h>
+#endif
+
+enum ReportOffset {
+    REPORT_X            = 0,
+    REPORT_Y            = 1,
+    REPORT_Z            = 2,
+    REPORT_RX           = 3,
+    REPORT_BUTTONS_LO   = 4,
+    REPORT_BUTTONS_HI   = 5,
+    REPORT_FORMAT       = 6,
+    REPORT_SEQUENCE     = 7,
+    REPORT_TIMESTAMP    = 8,
+    REPORT_FRACTION     = 10,
+    REPORT_ECHO         = 11,
+    REPORT_HOLD         = 12,
+    REPORT_HIRES        = 13,
+    REPORT_SIZE         = 19,
+
+    REPORT_MOUSE_X      = 0,
+    REPORT_MOUSE_Y      = 1,
+    REPORT_MOUSE_BUTTONS = 4,
+};
+
+static const unsigned REPORT_NUM_AXES = 4;
+static const unsigned REPORT_NUM_BUTTONS = 15;
+
+// High-res lanes; an 8-bit axis is the top byte of its lane
+static const unsigned REPORT_HIRES_BITS = 12;
+static const int REPORT_HIRES_MAX = 2047;
+
+enum ReportFormat {
+    REPORT_FORMAT_BASIC = 0,
+    REPORT_FORMAT_SEQUENCED = 1,
+    REPORT_FORMAT_ECHO  = 2,
+    REPORT_FORMAT_HIRES = 3,
+    REPORT_FORMAT_LATEST = REPORT_FORMAT_HIRES,
+    REPORT_FORMAT_MASK  = 0x0F,
+};
+
+enum ReportMode {
+    REPORT_MODE_JOYSTICK = 0,
+    REPORT_MODE_MOUSE   = 1,
+    REPORT_MODE_COUNT,
+    REPORT_MODE_SHIFT   = 4,
+};
+
+// Bit N of the 16-bit (little-endian) button word is button N+1
+enum ReportButton {
+    BUTTON_A        = 1 << 0,
+    BUTTON_B        = 1 << 1,
+    BUTTON_C        = 1 << 2,
+    BUTTON_X        = 1 << 3,
+    BUTTON_Y        = 1 << 4,
+    BUTTON_Z        = 1 << 5,
+    BUTTON_L1       = 1 << 6,
+    BUTTON_R1       = 1 << 7,
+    BUTTON_L2       = 1 << 8,
+    BUTTON_R2       = 1 << 9,
+    BUTTON_START    = 1 << 10,
+    BUTTON_SELECT   = 1 << 11,
+    BUTTON_MODE     = 1 << 12,
+    BUTTON_T1       = 1 << 13,
+    BUTTON_T2       = 1 << 14,
+};
+
+enum MouseButton {
+    MOUSE_LEFT      = 1 << 0,
+    MOUSE_RIGHT     = 1 << 1,
+    MOUSE_MIDDLE    = 1 << 2,
+};
+
+enum HostMessageType {
+    HOST_MSG_PING       = 0x01,     // No body; only asks for an echo
+    HOST_MSG_PROFILE    = 0x02,     // Body: REPORT_MODE_* to switch to
+    HOST_MSG_FEEDBACK   = 0x03,     // Body: feedback entries, see below
+    HOST_MSG_TILES      = 0x04,     // Body: tile runs for one cube, see below
+};
+
+static const unsigned HOST_MSG_ID = 0;
+static const unsigned HOST_MSG_BODY = 1;
+static const unsigned ECHO_HOLD_UNIT_US = 100;
+static const uint8_t ECHO_HOLD_INVALID = 255;
+
+/*
+ * HOST_MSG_FEEDBACK is a visual "rumble": up to FEEDBACK_MAX_ENTRIES
+ * entries, one per cube, each FEEDBACK_ENTRY_SIZE bytes. A target of
+ * FEEDBACK_END ends the list early.
+ *
+ *   [0]     Target      Role (0 stick, 1 left, 2 right), or FEEDBACK_CUBE | cube
+ *   [1]     Effect      FEEDBACK_EFFECT_*
+ *   [2]     Color       FEEDBACK_COLOR_*
+ *   [3]     Arg         FLASH: rate in Hz, 0 for the default; ICON: ASCII glyph
+ *   [4]     Duration    10 ms units; 0 lasts until the cube's next entry
+ *
+ * Its echo is held back until the frame showing the effect has been
+ * rendered on the cubes, and Hold counts from then instead of from
+ * arrival, so a report's timestamp minus the hold is when the effect
+ * reached the screen.
+ */
+enum FeedbackField {
+    FEEDBACK_TARGET     = 0,
+    FEEDBACK_EFFECT     = 1,
+    FEEDBACK_COLOR      = 2,
+    FEEDBACK_ARG        = 3,
+    FEEDBACK_DURATION   = 4,
+    FEEDBACK_ENTRY_SIZE = 5,
+};
+
+enum FeedbackEffect {
+    FEEDBACK_EFFECT_OFF     = 0,    // Back to the normal screen
+    FEEDBACK_EFFECT_SOLID   = 1,    // Border in Color
+    FEEDBACK_EFFECT_FLASH   = 2,    // Border blinking in Color
+    FEEDBACK_EFFECT_ICON    = 3,    // Border in Color, glyph in the middle
+    FEEDBACK_NUM_EFFECTS,
+};
+
+enum FeedbackColor {
+    FEEDBACK_COLOR_RED      = 0,
+    FEEDBACK_COLOR_ORANGE   = 1,
+    FEEDBACK_COLOR_YELLOW   = 2,
+    FEEDBACK_COLOR_BLUE     = 3,
+    FEEDBACK_COLOR_GRAY     = 4,
+    FEEDBACK_NUM_COLORS,
+};
+
+static const unsigned FEEDBACK_MAX_ENTRIES = 3;
+static const unsigned FEEDBACK_DURATION_UNIT_MS = 10;
+static const uint8_t FEEDBACK_CUBE = 0x80;
+static const uint8_t FEEDBACK_END = 0xFF;
+
+/*
+ * HOST_MSG_TILES draws on a cube's screen, one 16 x 16 grid of BG0_ROM
+ * tiles. A tile is a 16-bit word: the glyph in the low byte (ASCII 0x20 to
+ * 0x7E, or TILE_SOLID for a solid block) and FEEDBACK_COLOR_* in the high
+ * byte. Any tiles message takes the screen away from the status display;
+ * TILES_RELEASE gives it back.
+ *
+ *   [0]     Target      As for feedback
+ *   [1]     Flags       TILES_CLEAR blanks the screen before the runs;
+ *                       TILES_RELEASE hands it back, and has no runs
+ *   [2]     Start       Position of the first run, y * 16 + x
+ *   [3]     Counts      Dictionary words in bits 0-1, run bytes in bits 2-7
+ *   [4..]   Dictionary  Tile words, little-endian
+ *   then    Runs        Bits 6-7: a dictionary index, or TILES_SKIP to leave
+ *                       the tiles as they are; bits 0-5: length - 1
+ *
+ * Runs go on row-major from Start. The outer ring belongs to feedback and
+ * the neighbor indicators and is never written; runs crossing it skip it.
+ * Every message is absolute, so resending one is harmless.
+ */
+enum TilesField {
+    TILES_TARGET        = 0,
+    TILES_FLAGS         = 1,
+    TILES_START         = 2,
+    TILES_COUNTS        = 3,
+    TILES_DICT          = 4,
+};
+
+enum TilesFlag {
+    TILES_CLEAR         = 1 << 0,
+    TILES_RELEASE       = 1 << 1,
+};
+
+static const unsigned TILES_GRID = 16;
+static const unsigned TILES_BODY_SIZE = REPORT_SIZE - HOST_MSG_BODY;
+static const unsigned TILES_MAX_DICT = 3;
+static const unsigned TILES_SKIP = 3;
+static const unsigned TILES_MAX_RUN = 64;
+static const uint16_t TILE_SOLID = 0x7F;
+static const uint16_t TILE_BLANK = ' ';
+
+inline bool tileOnBorder(unsigned pos)
+{
+    unsigned x = pos % TILES_GRID, y = pos / TILES_GRID;
+    return x == 0 || y == 0 || x == TILES_GRID - 1 || y == TILES_GRID - 1;
+}
+
+/*
+ * Host tools carry packets over byte streams (sockets, pipes, files) as
+ * fixed-size frames: the 7-bit packet type, then the full payload.
+ */
+static const unsigned REPORT_FRAME_SIZE = 1 + REPORT_SIZE;
+
+struct ReportState {
+    int8_t axis[REPORT_NUM_AXES];
+    int16_t hires[REPORT_NUM_AXES]; // 12-bit; axis[] << 4 before REPORT_FORMAT_HIRES
+    uint16_t buttons;
+    uint8_t format;
+    uint8_t mode;           // REPORT_MODE_*; axis[] and buttons are per mode
+    uint8_t sequence;       // Zero before REPORT_FORMAT_SEQUENCED
+    uint16_t timestampMS;
+    uint8_t fraction;       // The rest are zero before REPORT_FORMAT_ECHO
+    uint8_t echo;
+    uint8_t hold;
+
+    // Timestamp in microseconds; wraps along with timestampMS
+    uint32_t timestampUS() const {
+        return timestampMS * 1000u + ((fraction * 1000u) >> 8);
+    }
+};
+
+/*
+ * Fill in the header the base adds when committing a report, from its
+ * uptime in microseconds. No echo is pending unless stampEcho() follows.
+ * The format becomes at least REPORT_FORMAT_ECHO; a report that already
+ * carries later fields (packHires()) keeps its format.
+ */
+inline void stampReport(uint8_t *bytes, uint8_t sequence, uint64_t uptimeUS)
+{
+    uint64_t ms = uptimeUS / 1000;
+    unsigned us = unsigned(uptimeUS - ms * 1000);
+
+    if ((bytes[REPORT_FORMAT] & REPORT_FORMAT_MASK) < REPORT_FORMAT_ECHO)
+        bytes[REPORT_FORMAT] = (bytes[REPORT_FORMAT] & ~REPORT_FORMAT_MASK) | REPORT_FORMAT_ECHO;
+    bytes[REPORT_SEQUENCE] = sequence;
+    bytes[REPORT_TIMESTAMP] = uint8_t(ms);
+    bytes[REPORT_TIMESTAMP + 1] = uint8_t(ms >> 8);
+    bytes[REPORT_FRACTION] = uint8_t((us << 8) / 1000);
+    bytes[REPORT_ECHO] = 0;
+    bytes[REPORT_HOLD] = 0;
+}
+
+inline void stampEcho(uint8_t *bytes, uint8_t id, unsigned holdUS)
+{
+    // Rounded, so the host's offset estimate isn't biased by half a unit
+    unsigned hold = (holdUS + ECHO_HOLD_UNIT_US / 2) / ECHO_HOLD_UNIT_US;
+    bytes[REPORT_ECHO] = id;
+    bytes[REPORT_HOLD] = hold < ECHO_HOLD_INVALID ? hold : ECHO_HOLD_INVALID;
+}
+
+inline unsigned hiresLane(int v)
+{
+    if (v > REPORT_HIRES_MAX)
+        v = REPORT_HIRES_MAX;
+    if (v < -REPORT_HIRES_MAX - 1)
+        v = -REPORT_HIRES_MAX - 1;
+    return unsigned(v) & 0xFFF;
+}
+
+/*
+ * Store four axes, clamped to 12 bits, in the high-res lanes and mark the
+ * report REPORT_FORMAT_HIRES. Two lanes go in every three bytes.
+ */
+inline void packHires(uint8_t *bytes, const int *axes)
+{
+    uint8_t *p = bytes + REPORT_HIRES;
+    for (unsigned i = 0; i < REPORT_NUM_AXES; i += 2, p += 3) {
+        unsigned lo = hiresLane(axes[i]);
+        unsigned hi = hiresLane(axes[i + 1]);
+        p[0] = uint8_t(lo);
+        p[1] = uint8_t((lo >> 8) | (hi << 4));
+        p[2] = uint8_t(hi >> 4);
+    }
+    bytes[REPORT_FORMAT] = (bytes[REPORT_FORMAT] & ~REPORT_FORMAT_MASK) | REPORT_FORMAT_HIRES;
+}
+
+// Set the report's mode; stampReport() leaves it alone
+inline void setReportMode(uint8_t *bytes, unsigned mode)
+{
+    bytes[REPORT_FORMAT] = (bytes[REPORT_FORMAT] & REPORT_FORMAT_MASK) | (mode << REPORT_MODE_SHIFT);
+}
+
+/*
+ * Decode the fields every format shares. Later formats only add to the
+ * reserved bytes, so this is always safe to call first.
+ */
+inline void decodeReport(const uint8_t *bytes, ReportState &out)
+{
+    for (unsigned i = 0; i < REPORT_NUM_AXES; ++i)
+        out.axis[i] = (int8_t) bytes[REPORT_X + i];
+    out.buttons = bytes[REPORT_BUTTONS_LO] | (bytes[REPORT_BUTTONS_HI] << 8);
+    out.format = bytes[REPORT_FORMAT] & REPORT_FORMAT_MASK;
+    out.mode = bytes[REPORT_FORMAT] >> REPORT_MODE_SHIFT;
+
+    if (out.format >= REPORT_FORMAT_SEQUENCED) {
+        out.sequence = bytes[REPORT_SEQUENCE];
+        out.timestampMS = bytes[REPORT_TIMESTAMP] | (bytes[REPORT_TIMESTAMP + 1] << 8);
+    } else {
+        out.sequence = 0;
+        out.timestampMS = 0;
+    }
+
+    if (out.format >= REPORT_FORMAT_ECHO) {
+        out.fraction = bytes[REPORT_FRACTION];
+        out.echo = bytes[REPORT_ECHO];
+        out.hold = bytes[REPORT_HOLD];
+    } else {
+        out.fraction = 0;
+        out.echo = 0;
+        out.hold = 0;
+    }
+
+    if (out.format >= REPORT_FORMAT_HIRES) {
+        const uint8_t *p = bytes + REPORT_HIRES;
+        for (unsigned i = 0; i < REPORT_NUM_AXES; i += 2, p += 3) {
+            unsigned lo = p[0] | ((p[1] & 0x0F) << 8);
+            unsigned hi = (p[1] >> 4) | (p[2] << 4);
+            out.hires[i] = int16_t(int(lo ^ 0x800) - 0x800);
+            out.hires[i + 1] = int16_t(int(hi ^ 0x800) - 0x800);
+        }
+    } else {
+        for (unsigned i = 0; i < REPORT_NUM_AXES; ++i)
+            out.hires[i] = int16_t(out.axis[i] * 16);
+    }
+}
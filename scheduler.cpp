@@ -0,0 +1,53 @@
+/*
+ * Cooperative scheduler for the main loop's background work.
+ */
+
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+void Scheduler::init(const Task *t, unsigned n, SystemTime now)
+{
+    bzero(*this);
+    ASSERT(n <= kMaxTasks);
+
+    tasks = t;
+    count = n;
+    for (unsigned i = 0; i < count; ++i)
+        next[i] = now + TimeDelta::fromMillisec(tasks[i].periodMS + i * kFrameMS);
+}
+
+void Scheduler::runFrame(SystemTime now)
+{
+    unsigned due = count;
+    for (unsigned i = 0; i < count; ++i) {
+        if (next[i] > now)
+            continue;
+        if (due == count || next[i] < next[due])
+            due = i;
+        taskStats[i].deferred++;
+    }
+    if (due == count)
+        return;
+
+    const Task &t = tasks[due];
+    TaskStats &s = taskStats[due];
+    s.deferred--;
+
+    t.run();
+
+    unsigned us = (SystemTime::now() - now).nanoseconds() / 1000;
+    s.runs++;
+    if (us > t.budgetUS)
+        s.overruns++;
+    if (us > s.worstUS)
+        s.worstUS = us;
+
+    // Keep the cadence, unless we're so far behind that catching up would clump
+    TimeDelta period = TimeDelta::fromMillisec(t.periodMS);
+    next[due] = next[due] + period;
+    if (next[due] <= now) {
+        s.skipped++;
+        next[due] = now + period;
+    }
+}
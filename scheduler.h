@@ -0,0 +1,62 @@
+/*
+ * Cooperative scheduler for the main loop's background work.
+ *
+ * Input never waits on this: sensor events, report building and the
+ * per-frame polling stay where they are. What it runs is everything that
+ * used to happen in one lump every 60 frames (the stats capture, the link
+ * monitor, the dashboard, the advertisement, calibration writes, logging),
+ * now as named tasks with their own period and time budget.
+ *
+ * runFrame() runs at most one task per frame, the most overdue one, so
+ * tasks that share a period land on consecutive frames instead of the
+ * same one; their first deadlines are staggered a frame apart to start
+ * with. A task's next deadline counts from its previous one, not from when
+ * it actually ran, so waiting a frame or two doesn't make it drift. Each
+ * run is timed against the task's budget; a task that goes over is only
+ * counted, since there is nothing to preempt, but the counters show where
+ * frames are going.
+ */
+
+#pragma once
+#include "app.h"
+
+class Scheduler {
+public:
+    static const unsigned kMaxTasks = 8;
+    static const unsigned kFrameMS = 16;
+
+    typedef void (*TaskFn)();
+
+    struct Task {
+        const char *name;
+        TaskFn run;
+        uint16_t periodMS;
+        uint16_t budgetUS;
+    };
+
+    struct TaskStats {
+        unsigned runs;
+        unsigned overruns;      // Took longer than budgetUS
+        unsigned deferred;      // Frames spent due behind another task
+        unsigned skipped;       // Whole periods missed
+        unsigned worstUS;
+    };
+
+    // tasks must outlive the scheduler; at most kMaxTasks
+    void init(const Task *tasks, unsigned count, SystemTime now);
+
+    // From the main loop, once a frame
+    void runFrame(SystemTime now);
+
+    unsigned numTasks() const { return count; }
+    const Task &task(unsigned i) const { return tasks[i]; }
+    const TaskStats &stats(unsigned i) const { return taskStats[i]; }
+
+private:
+    const Task *tasks;
+    unsigned count;
+    SystemTime next[kMaxTasks];
+    TaskStats taskStats[kMaxTasks];
+};
+
+extern Scheduler scheduler;
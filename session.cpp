@@ -0,0 +1,51 @@
+/*
+ * Session state that survives Bluetooth reconnects.
+ */
+
+#include "session.h"
+
+Session session;
+
+void Session::init()
+{
+    bzero(*this);
+}
+
+void Session::onConnect()
+{
+    connectedAt = SystemTime::now();
+    freshPending = true;
+    usedPrebuilt = false;
+}
+
+void Session::onDisconnect()
+{
+    freshPending = false;
+    prebuild();
+}
+
+void Session::setMode(unsigned mode)
+{
+    if (mode == reportMode)
+        return;
+
+    MCC_LOG(LOG_CAT_SESSION, LOG_LEVEL_INFO, "Session: report mode %d -> %d\n", reportMode, mode);
+    reportMode = mode;
+
+    // A prebuilt report in the old layout would confuse the host
+    primed = false;
+}
+
+void Session::recordFreshInput(SystemTime now)
+{
+    freshPending = false;
+
+    unsigned us = (now - connectedAt).nanoseconds() / 1000;
+    lastUS = us;
+    worstUS = max(worstUS, us);
+    bestUS = numReconnects ? min(bestUS, us) : us;
+    numReconnects++;
+
+    MCC_LOG(LOG_CAT_SESSION, LOG_LEVEL_INFO, "Session: fresh input %d us after connect (%s first), best %d worst %d\n",
+        us, usedPrebuilt ? "prebuilt" : "cold", bestUS, worstUS);
+}
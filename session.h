@@ -0,0 +1,91 @@
+/*
+ * Session state that survives Bluetooth reconnects.
+ *
+ * Stats, link monitor state and the packet counters already live for the
+ * whole run; what the session adds is a report that is kept ready while
+ * we're disconnected, so the first packet after bluetoothConnect goes out
+ * without waiting on a cold build. The report mode the host picked also
+ * carries over.
+ *
+ * The prebuilt report goes out from inside the connect handler, so timing
+ * it would only time that handler. What we measure instead is how long
+ * after connecting the first report built from fresh input is ready: the
+ * first one when nothing was prebuilt, otherwise the next one, which waits
+ * until the queue and the link monitor's rate allow another report.
+ */
+
+#pragma once
+#include "app.h"
+
+class Session {
+public:
+    void init();
+
+    // Called on disconnect, and from the main loop every frame while disconnected
+    void prebuild()
+    {
+        buildReport(report, false);
+        primed = true;
+    }
+
+    void onConnect();
+    void onDisconnect();
+
+    /*
+     * If this is the first packet since connecting and a prebuilt report is
+     * ready, copy it out and return true.
+     */
+    bool takePrebuilt(uint8_t *bytes)
+    {
+        if (!freshPending || !primed)
+            return false;
+        memcpy8(bytes, report, reportSize);
+        primed = false;
+        usedPrebuilt = true;
+        return true;
+    }
+
+    // A report was built from current input, sent or not
+    void onBuilt(SystemTime now)
+    {
+        if (freshPending)
+            recordFreshInput(now);
+    }
+
+    void onSent(const uint8_t *bytes)
+    {
+        memcpy8(report, bytes, reportSize);
+    }
+
+    /*
+     * Sequence numbers continue across reconnects, so the host can tell
+     * reports lost in a drop from reports that were never generated.
+     */
+    uint8_t nextSequence() { return sequence++; }
+
+    // REPORT_MODE_*, as last selected by the host
+    unsigned mode() const { return reportMode; }
+    void setMode(unsigned mode);
+
+    // Connect to the first report with fresh input
+    unsigned reconnects() const { return numReconnects; }
+    unsigned lastFreshInputUS() const { return lastUS; }
+    unsigned bestFreshInputUS() const { return bestUS; }
+    unsigned worstFreshInputUS() const { return worstUS; }
+
+private:
+    uint8_t report[reportSize];     // Prebuilt while disconnected, else last sent
+    bool primed;
+    bool freshPending;          // Connected; no report built from fresh input yet
+    bool usedPrebuilt;
+    uint8_t sequence;
+    uint8_t reportMode;
+    SystemTime connectedAt;
+
+    unsigned numReconnects;
+    unsigned lastUS, bestUS, worstUS;
+
+    void recordFreshInput(SystemTime now);
+};
+
+extern Session session;
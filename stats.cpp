@@ -0,0 +1,72 @@
+/*
+ * Cheap runtime statistics for the transmit path.
+ */
+
+#include "stats.h"
+
+Stats stats;
+
+void Stats::init()
+{
+    bzero(*this);
+    lastCapture = SystemTime::now();
+}
+
+unsigned Stats::percentile(unsigned total, unsigned pct) const
+{
+    // Upper edge of the bucket containing the pct'th percentile, in microseconds
+    unsigned target = (total * pct + 99) / 100;
+    unsigned sum = 0;
+
+    for (unsigned i = 0; i < kLatencyBuckets; ++i) {
+        sum += latency[i];
+        if (sum >= target)
+            return ((i + 1) << kLatencyShift) / 1000;
+    }
+    return (kLatencyBuckets << kLatencyShift) / 1000;
+}
+
+const Stats::Snapshot &Stats::capture()
+{
+    SystemTime now = SystemTime::now();
+    unsigned ms = (now - lastCapture).milliseconds();
+    if (ms == 0)
+        return snap;
+    lastCapture = now;
+
+    btCounters.capture();
+    unsigned tx = btCounters.sentPackets();
+    unsigned rx = btCounters.receivedPackets();
+    unsigned drop = btCounters.userPacketsDropped();
+
+    snap.txPerSec = (tx - lastTx) * 1000 / ms;
+    snap.rxPerSec = (rx - lastRx) * 1000 / ms;
+    snap.dropPerSec = (drop - lastDrop) * 1000 / ms;
+    lastTx = tx;
+    lastRx = rx;
+    lastDrop = drop;
+
+    snap.queuePercent = queueSlots ? queueFill * 100 / queueSlots : 0;
+    queueFill = queueSlots = 0;
+
+    for (unsigned i = 0; i < numCubes; ++i) {
+        snap.accelPerSec[i] = accelEvents[i] * 1000 / ms;
+        accelEvents[i] = 0;
+    }
+
+    unsigned total = 0;
+    for (unsigned i = 0; i < kLatencyBuckets; ++i)
+        total += latency[i];
+
+    snap.latencySamples = total;
+    if (total) {
+        snap.latencyP50 = percentile(total, 50);
+        snap.latencyP90 = percentile(total, 90);
+        snap.latencyP99 = percentile(total, 99);
+    } else {
+        snap.latencyP50 = snap.latencyP90 = snap.latencyP99 = 0;
+    }
+    bzero(latency);
+
+    return snap;
+}
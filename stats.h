@@ -0,0 +1,96 @@
+/*
+ * Cheap runtime statistics for the transmit path.
+ *
+ * The hooks called from event handlers only bump counters or a histogram
+ * bucket; all arithmetic (rates, percentiles) is done in capture(), which
+ * the main loop calls at a low rate.
+ */
+
+#pragma once
+#include "app.h"
+
+class Stats {
+public:
+    /*
+     * Sensor-to-send latency histogram. Buckets are 2^19 ns (~0.5 ms) wide
+     * so that the bucket index is a shift, not a division.
+     */
+    static const unsigned kLatencyShift = 19;
+    static const unsigned kLatencyBuckets = 64;
+
+    struct Snapshot {
+        unsigned txPerSec;
+        unsigned rxPerSec;
+        unsigned dropPerSec;
+        unsigned queuePercent;      // Average send queue occupancy
+        unsigned latencyP50;        // Sensor-to-send latency, microseconds
+        unsigned latencyP90;
+        unsigned latencyP99;
+        unsigned latencySamples;
+        unsigned accelPerSec[numCubes];
+    };
+
+    void init();
+
+    // Called from SensorListener::onAccelChange()
+    void onSensorEvent(unsigned id)
+    {
+        accelEvents[id]++;
+        if (!pending[id]) {
+            pending[id] = true;
+            pendingSince[id] = SystemTime::now();
+        }
+    }
+
+    // Called from onWriteAvailable() right before a packet is committed
+    void onPacketSent()
+    {
+        SystemTime now;
+        bool haveNow = false;
+
+        for (unsigned i = 0; i < numCubes; ++i) {
+            if (!pending[i])
+                continue;
+            if (!haveNow) {
+                now = SystemTime::now();
+                haveNow = true;
+            }
+            uint64_t ns = (now - pendingSince[i]).nanoseconds();
+            unsigned bucket = ns >> kLatencyShift;
+            latency[bucket < kLatencyBuckets ? bucket : kLatencyBuckets - 1]++;
+            pending[i] = false;
+        }
+    }
+
+    // Called once per frame from the main loop
+    void sampleQueue(unsigned count, unsigned capacity)
+    {
+        queueFill += count;
+        queueSlots += capacity;
+    }
+
+    /*
+     * Fold everything accumulated since the last call into a new snapshot.
+     * Also captures btCounters, so the caller doesn't have to.
+     */
+    const Snapshot &capture();
+
+    const Snapshot &last() const { return snap; }
+
+private:
+    Snapshot snap;
+    SystemTime lastCapture;
+
+    unsigned lastTx, lastRx, lastDrop;
+    unsigned queueFill, queueSlots;
+
+    unsigned accelEvents[numCubes];
+    bool pending[numCubes];
+    SystemTime pendingSince[numCubes];
+
+    uint32_t latency[kLatencyBuckets];
+
+    unsigned percentile(unsigned total, unsigned pct) const;
+};
+
+extern Stats stats;
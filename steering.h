@@ -0,0 +1,98 @@
+/*
+ * Steering-wheel mode: a cube's roll angle as a joystick axis.
+ *
+ * The angle comes from the gravity vector alone, in integers: roll is
+ * atan2(x, |(y, z)|), so it doesn't care how far the cube is pitched or
+ * which way up its screen is, and covers +/-90 degrees. |(y, z)| is a
+ * bitwise integer square root carrying four fractional bits, and atan is a
+ * 65-entry table over [0, 1] with linear interpolation, reached by octant
+ * folding. The result is in binary angle units (65536 per turn; 16384 =
+ * 90 deg), within about a tenth of a degree once there's real gravity in
+ * the reading, for one division plus one more by the (usually constant)
+ * lock span.
+ *
+ * steeringAxis() turns that into a signed 16-bit axis through the lock-
+ * to-lock range and a center dead zone; the 8-bit report axis is its top
+ * byte, so the wheel uses the axis's whole range with no hole at zero.
+ *
+ * Shared with the host tools; no SDK dependency.
+ */
+
+#pragma once
+#include "report.h"
+
+struct SteeringConfig {
+    bool enabled;
+    uint8_t cube;               // Role index, as in MappingAxis
+    uint16_t halfLock;          // Binary angle at full lock, either way
+    uint16_t deadZone;          // Binary angle either side of center
+};
+
+static const unsigned STEERING_QUARTER_TURN = 16384;
+
+// atan(i / 64) in binary angle units
+static const uint16_t steeringAtan[65] = {
+        0,   163,   326,   489,   651,   813,   975,  1136,
+     1297,  1457,  1617,  1775,  1933,  2090,  2246,  2401,
+     2555,  2708,  2860,  3010,  3159,  3307,  3453,  3599,
+     3742,  3884,  4025,  4164,  4302,  4438,  4572,  4705,
+     4836,  4966,  5094,  5220,  5344,  5467,  5589,  5708,
+     5826,  5943,  6058,  6171,  6282,  6392,  6500,  6607,
+     6712,  6815,  6917,  7018,  7117,  7214,  7310,  7405,
+     7498,  7589,  7679,  7768,  7856,  7942,  8026,  8110,
+     8192,
+};
+
+// atan(num / den) for 0 <= num <= den, den > 0
+inline unsigned steeringAtanRatio(unsigned num, unsigned den)
+{
+    unsigned q = (num << 12) / den;         // 0..4096
+    unsigned i = q >> 6, frac = q & 63;
+    if (i == 64)
+        return steeringAtan[64];
+    return steeringAtan[i] + (((steeringAtan[i + 1] - steeringAtan[i]) * frac + 32) >> 6);
+}
+
+// floor(sqrt(v)) for v < 2^24: twelve fixed iterations, no branches
+inline unsigned steeringSqrt(unsigned v)
+{
+    unsigned root = 0;
+    for (unsigned bit = 1 << 22; bit; bit >>= 2) {
+        unsigned trial = root + bit;
+        unsigned take = -unsigned(v >= trial);
+        v -= trial & take;
+        root = (root >> 1) + (bit & take);
+    }
+    return root;
+}
+
+// Roll in binary angle units, -16384..16384; positive when x is
+inline int steeringRoll(int x, int y, int z)
+{
+    // Both sides of the ratio carry four fractional bits
+    unsigned ax = (x < 0 ? -x : x) << 4;
+    unsigned d = steeringSqrt(unsigned(y * y + z * z) << 8);
+
+    unsigned a;
+    if (ax == 0 && d == 0)
+        a = 0;
+    else if (ax <= d)
+        a = steeringAtanRatio(ax, d);
+    else
+        a = STEERING_QUARTER_TURN - steeringAtanRatio(d, ax);
+
+    return x < 0 ? -int(a) : int(a);
+}
+
+// Roll mapped through lock and dead zone, -32767..32767
+inline int steeringAxis(const SteeringConfig &c, int x, int y, int z)
+{
+    int roll = steeringRoll(x, y, z);
+    unsigned mag = roll < 0 ? -roll : roll;
+    if (mag <= c.deadZone)
+        return 0;
+
+    unsigned span = c.halfLock - c.deadZone;
+    unsigned v = mag >= c.halfLock ? 32767 : (mag - c.deadZone) * 32767 / span;
+    return roll < 0 ? -int(v) : int(v);
+}
@@ -0,0 +1,76 @@
+/*
+ * SIMD-within-a-register helpers: four int8 lanes in a uint32_t.
+ *
+ * Lane 0 is the low byte. Every operation here keeps each lane's
+ * arithmetic inside its own byte (no carry or borrow crosses a lane), and
+ * none of them branch on the data, so a whole report's worth of axes or
+ * thresholds costs a handful of ALU ops on the Cortex-M3.
+ *
+ * Shared with the host tools; no SDK dependency.
+ */
+
+#pragma once
+#include "report.h"
+
+static const uint32_t SWAR_HIGH = 0x80808080;
+static const uint32_t SWAR_LOW7 = 0x7F7F7F7F;
+static const uint32_t SWAR_ONES = 0x01010101;
+
+inline uint32_t swarPack(int8_t a, int8_t b, int8_t c, int8_t d)
+{
+    return uint8_t(a) | (uint8_t(b) << 8) | (uint8_t(c) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+inline void swarStore(uint32_t w, uint8_t *bytes)
+{
+    bytes[0] = w;
+    bytes[1] = w >> 8;
+    bytes[2] = w >> 16;
+    bytes[3] = w >> 24;
+}
+
+// 0xFF in every lane whose high bit is set in h, 0x00 elsewhere
+inline uint32_t swarSpread(uint32_t h)
+{
+    return ((h & SWAR_HIGH) >> 7) * 0xFF;
+}
+
+/*
+ * Lane-wise unsigned x >= y, as the high bit of each lane. The low seven
+ * bits are compared with a borrow-free subtract; the high bits decide
+ * whenever they differ.
+ */
+inline uint32_t swarGreaterEqual(uint32_t x, uint32_t y)
+{
+    uint32_t d = (x | SWAR_HIGH) - (y & SWAR_LOW7);
+    return ((x & ~y) | (~(x ^ y) & d)) & SWAR_HIGH;
+}
+
+// Gather the four lane high bits into bits 0..3
+inline unsigned swarNibble(uint32_t h)
+{
+    return ((h & SWAR_HIGH) * 0x00204081) >> 28;
+}
+
+/*
+ * The boost curve on four signed lanes at once: values strictly between
+ * 0 and +/-limit move away from zero by offset, everything else passes
+ * through. limitBias holds 0x80 - limit per lane and offset must keep
+ * limit - 1 + offset within 127.
+ *
+ * Works on magnitudes: negating a negative lane is ~v + 1, which can't
+ * carry out of the lane for -128..-1, and neither can undoing it after.
+ */
+inline uint32_t swarBoost(uint32_t v, uint32_t offset, uint32_t limitBias)
+{
+    uint32_t neg = swarSpread(v);
+    uint32_t one = neg & SWAR_ONES;
+    uint32_t mag = (v ^ neg) + one;                             // 0..128
+
+    uint32_t below = ~(mag + limitBias);                        // mag < limit
+    uint32_t nonzero = mag + SWAR_LOW7;                         // mag > 0
+    uint32_t boost = swarSpread(below & nonzero);
+
+    mag += offset & boost;
+    return (mag ^ neg) + one;
+}
@@ -0,0 +1,187 @@
+/*
+ * The Tai mapping from cube motion to joystick report.
+ *
+ * This is the original hand-written mapping, as a pure function so the
+ * host tools (load generator, kernel benchmarks) can produce exactly the
+ * same reports. buildReport() now runs the table-driven version compiled
+ * from mapping.lua (see mapping.h), which must stay bit-exact with this
+ * while mapping.lua describes Tai. It only fills bytes [0..5]; see report.h.
+ */
+
+#pragma once
+#include "report.h"
+
+// Tilt needed to press a button, in raw accelerometer units
+static const int8_t TAI_TRIGGER = 30;
+
+struct TaiAccel {
+    int8_t x, y, z;
+};
+
+/*
+ * One sample of everything the mapping reads. Index 0/1/2 are the cubes
+ * holding the stick/left/right roles.
+ */
+struct TaiSample {
+    TaiAccel cube[3];
+    bool touching[3];
+    bool neighboring;
+};
+
+inline void taiMap(const TaiSample &s, uint8_t *bytes)
+{
+	const TaiAccel &accel_Cube0 = s.cube[0];
+	const TaiAccel &accel_Cube1 = s.cube[1];
+	const TaiAccel &accel_Cube2 = s.cube[2];
+	bool isTouching_Cube0 = s.touching[0];
+	bool isTouching_Cube1 = s.touching[1];
+	bool isTouching_Cube2 = s.touching[2];
+	bool neighboring = s.neighboring;
+
+	/**
+	 * Prepare the package, cube0 for the axis.X & axis.Y axis.Z
+	 * cube1 for the axis.Rx
+	 * 20 or 40 is used to gain the axis.X & axis.Y between 0 to 107		 
+	 * 107 and 20 need to be changed together due to our range for axis is 0~127
+	 */	
+	 
+	// accel_Cube0.x => X	bytes[0]
+	if (accel_Cube0.x < 87 && accel_Cube0.x > 0) {
+		bytes[0] = accel_Cube0.x + 40;
+	}
+	else if (accel_Cube0.x > -87 && accel_Cube0.x < 0) {
+		bytes[0] = accel_Cube0.x - 40;		
+	}
+	else {
+		bytes[0] = accel_Cube0.x;			
+	}
+	
+	// accel_Cube0.y => Y	bytes[1]		
+	if (accel_Cube0.y < 107 && accel_Cube0.y > 0) {
+		bytes[1] = accel_Cube0.y + 20;
+	}
+	else if (accel_Cube0.y > -107 && accel_Cube0.y < 0) {
+		bytes[1] = accel_Cube0.y - 20;		
+	}
+	else {
+		bytes[1] = accel_Cube0.y;			
+	}
+	
+	// accel_Cube0.z => Z	bytes[2]		
+	if (accel_Cube0.z < 107 && accel_Cube0.z > 0) {
+		bytes[2] = accel_Cube0.z + 20;
+	}
+	else if (accel_Cube0.z > -107 && accel_Cube0.z < 0) {
+		bytes[2] = accel_Cube0.z - 20;		
+	}
+	else {
+		bytes[2] = accel_Cube0.z;			
+	}
+	
+	// accel_Cube1.Z => Rx	bytes[3]		
+	if (accel_Cube1.z < 107 && accel_Cube1.z > 0) {
+		bytes[3] = accel_Cube1.z + 20;
+	}
+	else if (accel_Cube1.z > -107 && accel_Cube1.z < 0) {
+		bytes[3] = accel_Cube1.z - 20;		
+	}
+	else {
+		bytes[3] = accel_Cube1.z;			
+	}
+	
+	/**
+	 * Prepare the buttons, cube1&cube2 use the 15 bits equal 15 buttons
+	 * bytes[4] buttons 1~8: 0x01:A	0x02:B  0x04:C		0x08:X		0x10:Y		0x20:Z 	0x40:L1	0x80:R1
+	 * bytes[5] buttons 1~7: 0x01:L2	0x02:R2	0x04:Start	0x08:Select	0x10:Mode	0x20:T1	0x40:T2	
+	 * we need map above 15 buttons to all motions we have: 
+	 * 
+	 */
+	 
+	/**
+	 * Area	bytes[4]
+	 * buttons 1~8
+	 *  		 
+	 */	
+	int8_t Trigger = TAI_TRIGGER;		 
+//*******************************************************//		 
+
+	// accel_Cube1.y, 		
+	if (accel_Cube1.y > Trigger) {						//Down	(7,14)
+		bytes[4] = bytes[4] | 0x01;	//---A---//
+	}
+	else if (accel_Cube1.y < -Trigger) {				//Up	(7,1)
+		bytes[4] = bytes[4] | 0x04;	//---C---// 
+		
+	}
+	// accel_Cube1.x, 
+	if (accel_Cube1.x > Trigger) {						//Right	(14,7)
+		bytes[4] = bytes[4] | 0x02;	//---B---//
+	}
+	else if (accel_Cube1.x < -Trigger) {				//Left	(1,7)
+		bytes[4] = bytes[4] | 0x20;	//---Z---//
+		
+	}
+	
+//*******************************************************//
+
+	//accel_Cube2.y, 
+	if (accel_Cube2.y > Trigger) {						//Down	(7,14)
+		bytes[4] = bytes[4] | 0x08;	//---X---//
+	}
+	else if (accel_Cube2.y < -Trigger) {				//Up	(7,1)
+//			bytes[4] = bytes[4] | 0x10;	//---Y---// 
+		
+	}
+	
+	//accel_Cube2.x, 		
+	if (accel_Cube2.x > Trigger) {						//Right	(14,7)
+		bytes[4] = bytes[4] | 0x10;	//---Y---//
+	}			
+	else if (accel_Cube2.x < -Trigger) {				//Left	(1,7)
+//			bytes[4] = bytes[4] | 0x80;	//---R1---//
+		
+	}		
+//*******************************************************//
+	
+	//neighboring_Cube_all 		
+	if (neighboring) {
+		bytes[4] = bytes[4] | 0x02;	//---B---//
+		
+	}
+//*******************************************************//	
+	
+	//isTouching_Cube0&1&2, trigger 
+	if (isTouching_Cube0) {
+		bytes[4] = bytes[4] | 0x01;	//---A---//
+		
+	}
+	if (isTouching_Cube1) {
+		bytes[4] = bytes[4] | 0x40;	//---L1---//
+		
+	}
+	if (isTouching_Cube2) {
+		bytes[4] = bytes[4] | 0x80;	//---R1---//
+		
+	}
+
+	/**
+	 * Area	bytes[5]
+	 * buttons 1~7
+	 *  		 
+	 */	
+/*		
+		bytes[5] | = 0x01;	//L2
+	
+		bytes[5] | = 0x02;	//R2
+
+		bytes[5] | = 0x04;	//Start
+
+		bytes[5] | = 0x08;	//Select
+
+		bytes[5] | = 0x10;	//Mode
+
+		bytes[5] | = 0x20;	//T1
+
+		bytes[5] | = 0x40;	//T2
+*/		
+}
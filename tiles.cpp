@@ -0,0 +1,118 @@
+/*
+ * Tile graphics pushed by the host.
+ */
+
+#include "tiles.h"
+#include "feedback.h"
+#include "power.h"
+
+HostTiles hostTiles;
+
+void HostTiles::init(RestoreFn fn)
+{
+    bzero(*this);
+    restore = fn;
+}
+
+// Wire tile word to BG0_ROM tile; the ROM font starts at ' '
+bool HostTiles::romTile(uint16_t word, unsigned &tile)
+{
+    unsigned glyph = word & 0xFF;
+    unsigned color = word >> 8;
+    if (color >= FEEDBACK_NUM_COLORS)
+        return false;
+
+    if (glyph == TILE_SOLID)
+        tile = BG0ROMDrawable::SOLID_FG | Feedback::palette(color);
+    else if (glyph >= ' ' && glyph < TILE_SOLID)
+        tile = (glyph - ' ') | Feedback::palette(color);
+    else
+        return false;
+    return true;
+}
+
+void HostTiles::onMessage(const BluetoothPacket &packet)
+{
+    counters.messages++;
+    if (packet.size() < HOST_MSG_BODY + TILES_DICT) {
+        counters.rejected++;
+        return;
+    }
+
+    const uint8_t *body = packet.bytes() + HOST_MSG_BODY;
+    unsigned length = packet.size() - HOST_MSG_BODY;
+
+    unsigned target = body[TILES_TARGET];
+    unsigned id;
+    if (target & FEEDBACK_CUBE)
+        id = target & ~FEEDBACK_CUBE;
+    else if (target < Power::NUM_ROLES)
+        id = power.cubeFor(Power::Role(target));
+    else
+        id = numDisplays;
+    if (!hasDisplay(id)) {
+        counters.rejected++;
+        return;
+    }
+
+    if (body[TILES_FLAGS] & TILES_RELEASE) {
+        if (owns(id)) {
+            owned &= ~(1u << id);
+            counters.releases++;
+            vid[id].bg0rom.erase();
+            restore(id);
+        }
+        return;
+    }
+
+    // Check the whole message before drawing any of it
+    unsigned numDict = body[TILES_COUNTS] & 3;
+    unsigned numRuns = body[TILES_COUNTS] >> 2;
+    const uint8_t *runs = body + TILES_DICT + 2 * numDict;
+    unsigned dict[TILES_MAX_DICT];
+
+    bool ok = numDict <= TILES_MAX_DICT && TILES_DICT + 2 * numDict + numRuns <= length;
+    for (unsigned i = 0; ok && i < numDict; ++i) {
+        const uint8_t *w = body + TILES_DICT + 2 * i;
+        ok = romTile(w[0] | (w[1] << 8), dict[i]);
+    }
+    for (unsigned i = 0; ok && i < numRuns; ++i)
+        ok = (runs[i] >> 6) == TILES_SKIP || (runs[i] >> 6) < numDict;
+    if (!ok) {
+        counters.rejected++;
+        return;
+    }
+
+    BG0ROMDrawable &draw = vid[id].bg0rom;
+    if (!owns(id)) {
+        // Nothing of the status display stays behind, border included
+        owned |= 1u << id;
+        counters.claims++;
+        draw.erase();
+    }
+
+    if (body[TILES_FLAGS] & TILES_CLEAR) {
+        unsigned blank;
+        romTile(TILE_BLANK, blank);
+        draw.fill(vec(1,1), vec(TILES_GRID - 2, TILES_GRID - 2), blank);
+    }
+
+    unsigned pos = body[TILES_START];
+    for (unsigned i = 0; i < numRuns && pos < TILES_GRID * TILES_GRID; ++i) {
+        unsigned code = runs[i] >> 6;
+        unsigned end = pos + (runs[i] & (TILES_MAX_RUN - 1)) + 1;
+        if (end > TILES_GRID * TILES_GRID)
+            end = TILES_GRID * TILES_GRID;
+
+        if (code == TILES_SKIP) {
+            pos = end;
+            continue;
+        }
+        for (; pos < end; ++pos) {
+            if (tileOnBorder(pos))
+                continue;
+            draw.plot(vec(pos % TILES_GRID, pos / TILES_GRID), dict[code]);
+            counters.tiles++;
+        }
+    }
+}
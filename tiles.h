@@ -0,0 +1,50 @@
+/*
+ * Tile graphics pushed by the host.
+ *
+ * HOST_MSG_TILES (report.h) carries one cube's changed tiles as runs over
+ * a small dictionary of tile words, so an icon or a partial update costs a
+ * packet or two instead of the whole 256-tile screen. Messages are applied
+ * straight from the read handler: a message is at most a few runs of plain
+ * VRAM writes, and the host keeps only one in flight per controller, so
+ * this never adds up to enough work to delay a report.
+ *
+ * A cube that has received tiles is the host's until TILES_RELEASE: the
+ * status text, neighbor display, button labels and dashboard page leave it
+ * alone (main.cpp's drawsStatus()), while feedback effects still use its
+ * border, which pushed tiles never cover.
+ */
+
+#pragma once
+#include "app.h"
+
+class HostTiles {
+public:
+    struct Counters {
+        unsigned messages;
+        unsigned tiles;         // Tiles written
+        unsigned rejected;      // Bad target, counts, tile word or position
+        unsigned claims;
+        unsigned releases;
+    };
+
+    // Gives a released cube its normal screen back; the screen is erased first
+    typedef void (*RestoreFn)(unsigned id);
+
+    void init(RestoreFn restore);
+
+    // From HostLink::onMessage(), in the read handler
+    void onMessage(const BluetoothPacket &packet);
+
+    bool owns(unsigned id) const { return id < numDisplays && (owned >> id) & 1; }
+
+    const Counters &stats() const { return counters; }
+
+private:
+    uint32_t owned;             // Bit N: cube N shows host tiles
+    RestoreFn restore;
+    Counters counters;
+
+    static bool romTile(uint16_t word, unsigned &tile);
+};
+
+extern HostTiles hostTiles;
@@ -0,0 +1,40 @@
+/*
+ * Leveled, per-category logging, and a binary trace ring.
+ */
+
+#include "trace.h"
+
+Trace trace;
+
+static const char *eventName(unsigned event)
+{
+    static const char *names[] = {
+        "write", "sent", "redundant", "read", "received", "connect", "disconnect",
+    };
+    STATIC_ASSERT(arraysize(names) == TRACE_NUM_EVENTS);
+    return event < arraysize(names) ? names[event] : "?";
+}
+
+void Trace::init()
+{
+    bzero(*this);
+}
+
+void Trace::dump()
+{
+    if (!MCC_TRACE)
+        return;
+
+    unsigned count = total < numRecords ? total : numRecords;
+    LOG("Trace: %d records, %d overwritten\n", count, total - count);
+
+    unsigned i = (head + numRecords - count) % numRecords;
+    for (; count; --count, i = (i + 1) % numRecords) {
+        const Record &r = ring[i];
+        LOG("  %d us %s a=%d b=%04x\n",
+            unsigned((uint64_t(r.time) << 10) / 1000), eventName(r.event), r.a, r.b);
+    }
+
+    head = 0;
+    total = 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Leveled, per-category logging, and a binary trace ring.
+ *
+ * MCC_LOG(category, level, ...) is LOG() gated on MCC_LOG_LEVEL and the
+ * MCC_LOG_CATEGORIES mask. Both are compile-time constants (overridable
+ * from the Makefile), so a disabled call is dead code: its arguments are
+ * never evaluated and nothing of it is left in the binary.
+ *
+ * Per-packet events need visibility without per-packet formatting. With
+ * MCC_TRACE=1, TRACE(event, a, b) appends a fixed 8-byte record to a ring
+ * in RAM, and trace.dump() formats the ring through LOG() only when asked
+ * (when the dashboard is toggled). With MCC_TRACE=0, TRACE() is dead code
+ * too and the ring shrinks to a single record.
+ */
+
+#pragma once
+#include <sifteo.h>
+using namespace Sifteo;
+
+enum LogLevel {
+    LOG_LEVEL_NONE      = 0,
+    LOG_LEVEL_ERROR     = 1,
+    LOG_LEVEL_INFO      = 2,    // State changes, once-a-second counters
+    LOG_LEVEL_DEBUG     = 3,    // Sensor events
+    LOG_LEVEL_VERBOSE   = 4,    // Every packet
+};
+
+enum LogCategory {
+    LOG_CAT_PIPE        = 1 << 0,   // Bluetooth connect, read and write
+    LOG_CAT_LINK        = 1 << 1,
+    LOG_CAT_SESSION     = 1 << 2,
+    LOG_CAT_POWER       = 1 << 3,
+    LOG_CAT_SENSORS     = 1 << 4,
+    LOG_CAT_UI          = 1 << 5,
+    LOG_CAT_STATS       = 1 << 6,
+    LOG_CAT_ALL         = 0xFF,
+};
+
+#ifndef MCC_LOG_LEVEL
+#define MCC_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#ifndef MCC_LOG_CATEGORIES
+#define MCC_LOG_CATEGORIES LOG_CAT_ALL
+#endif
+
+#ifndef MCC_TRACE
+#define MCC_TRACE 0
+#endif
+
+#ifndef MCC_TRACE_RECORDS
+#define MCC_TRACE_RECORDS 128
+#endif
+
+#define MCC_LOG_ENABLED(category, level) \
+    ((level) <= MCC_LOG_LEVEL && ((category) & MCC_LOG_CATEGORIES))
+
+#define MCC_LOG(category, level, ...) \
+    do { if (MCC_LOG_ENABLED(category, level)) LOG(__VA_ARGS__); } while (0)
+
+enum TraceEvent {
+    TRACE_WRITE_CALLED,     // a = packets the queue can take
+    TRACE_SENT,             // a = sequence, b = buttons
+    TRACE_REDUNDANT,        // Report held back by the link monitor
+    TRACE_READ_CALLED,
+    TRACE_RECEIVED,         // a = packet type, b = size | first byte << 8
+    TRACE_CONNECT,
+    TRACE_DISCONNECT,
+    TRACE_NUM_EVENTS
+};
+
+class Trace {
+public:
+    void init();
+
+    void record(uint8_t event, uint8_t a, uint16_t b)
+    {
+        // Units of 1.024 us, so there's no division on the hot path
+        Record &r = ring[head];
+        r.time = SystemTime::now().uptimeNS() >> 10;
+        r.event = event;
+        r.a = a;
+        r.b = b;
+        head = (head + 1) % numRecords;
+        total++;
+    }
+
+    // Format everything in the ring through LOG(), oldest first, and empty it
+    void dump();
+
+private:
+    static const unsigned numRecords = MCC_TRACE ? MCC_TRACE_RECORDS : 1;
+
+    struct Record {
+        uint32_t time;
+        uint8_t event;
+        uint8_t a;
+        uint16_t b;
+    };
+
+    Record ring[numRecords];
+    unsigned head;
+    unsigned total;
+};
+
+extern Trace trace;
+
+#if MCC_TRACE
+#define TRACE(event, a, b)  trace.record(event, a, b)
+#else
+#define TRACE(event, a, b)  do {} while (0)
+#endif